@@ -0,0 +1,286 @@
+#ifndef _COMPRESSED_GRAPH_H_
+#define _COMPRESSED_GRAPH_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define COMPRESSED_GRAPH_SSSE3 1
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// An immutable, compressed snapshot of a graph's out-edges.
+///
+/// Vertices are renumbered densely into [0, n) in descriptor order, as in
+/// csr_graph. Each sorted neighbor list is gap-encoded with Stream VByte. The
+/// list starts with one control byte per group of four values, with two bits
+/// per value giving its length of 1-4 bytes. The value bytes follow. The
+/// first gap is taken from 0. Sorted lists from real graphs mostly have small
+/// gaps, so an edge costs a little over one byte. Edge properties are not
+/// stored.
+///
+/// Lists decode four values at a time with an SSSE3 byte shuffle when the CPU
+/// supports it, and with a scalar loop otherwise. Dense indices are 32-bit,
+/// so a snapshot holds fewer than 2^32 vertices.
+////////////////////////////////////////////////////////////////////////////////
+class compressed_graph {
+
+  public:
+
+    /// Marker for "no such vertex" in index() and in dense result arrays
+    enum : size_t {npos = size_t(-1)};
+
+    template<typename Graph>
+    explicit compressed_graph(const Graph& g) : edge_count(0), widest(0) {
+        desc.reserve(g.num_vertices());
+        for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v)
+            desc.push_back(v->first);
+
+        offsets.reserve(desc.size() + 1);
+        degrees.reserve(desc.size());
+        offsets.push_back(0);
+
+        std::vector<uint32_t> list;
+        for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v) {
+            // out-edges come out of the adjacency map sorted by target
+            list.clear();
+            for (auto e = v->second->cbegin(); e != v->second->cend(); ++e)
+                if (e->second->source() == v->first)
+                    list.push_back(uint32_t(index(e->second->target())));
+            encode(list);
+        }
+
+        // decoding loads 16 bytes at a time, so never let a load run off
+        // the end of the buffer
+        bytes.resize(bytes.size() + 16, 0);
+        bytes.shrink_to_fit();
+    }
+
+    size_t num_vertices() const {return desc.size();}
+    size_t num_edges() const {return edge_count;}
+    size_t degree(size_t v) const {return degrees[v];}
+    size_t max_degree() const {return widest;}
+
+    // dense index of a descriptor, or npos if it is not in the snapshot
+    size_t index(size_t vd) const {
+        auto i = std::lower_bound(desc.begin(), desc.end(), vd);
+        return i != desc.end() && *i == vd ? size_t(i - desc.begin()) : npos;
+    }
+
+    // descriptor of a dense index
+    size_t descriptor(size_t v) const {return desc[v];}
+
+    // Call f(u) for every out-neighbor u of v, in increasing order.
+    template<typename F>
+    void for_each_neighbor(size_t v, F f) const {
+        const size_t chunk = 64;
+        uint32_t buf[chunk];
+
+        const uint8_t* ctrl = &bytes[offsets[v]];
+        const uint8_t* data = ctrl + (degrees[v] + 3) / 4;
+        uint32_t prev = 0;
+
+        for (size_t left = degrees[v]; left != 0; ) {
+            size_t count = std::min(left, chunk);
+            data = decode(ctrl, data, count, prev, buf);
+            ctrl += count / 4;
+            left -= count;
+            for (size_t i = 0; i < count; ++i)
+                f(size_t(buf[i]));
+        }
+    }
+
+    // Decode the out-neighbors of v into out, which must have room for
+    // degree(v) values. Returns degree(v).
+    size_t neighbors(size_t v, uint32_t* out) const {
+        const uint8_t* ctrl = &bytes[offsets[v]];
+        uint32_t prev = 0;
+        decode(ctrl, ctrl + (degrees[v] + 3) / 4, degrees[v], prev, out);
+        return degrees[v];
+    }
+
+    // Total heap bytes held by the snapshot.
+    size_t memory_bytes() const {
+        return bytes.capacity() * sizeof(uint8_t) +
+               offsets.capacity() * sizeof(uint64_t) +
+               degrees.capacity() * sizeof(uint32_t) +
+               desc.capacity() * sizeof(size_t);
+    }
+
+    // Heap bytes of the encoded neighbor lists alone.
+    size_t adjacency_bytes() const {return bytes.size();}
+
+  private:
+
+    // Append one sorted neighbor list to bytes.
+    void encode(const std::vector<uint32_t>& list) {
+        size_t ctrl = bytes.size();
+        bytes.resize(ctrl + (list.size() + 3) / 4, 0);
+
+        uint32_t prev = 0;
+        for (size_t i = 0; i < list.size(); ++i) {
+            uint32_t gap = list[i] - prev;
+            prev = list[i];
+            uint8_t len = gap < (1u << 8) ? 1 : gap < (1u << 16) ? 2 :
+                          gap < (1u << 24) ? 3 : 4;
+            bytes[ctrl + i / 4] |= uint8_t((len - 1) << (2 * (i % 4)));
+            for (uint8_t b = 0; b < len; ++b)
+                bytes.push_back(uint8_t(gap >> (8 * b)));
+        }
+
+        offsets.push_back(bytes.size());
+        degrees.push_back(uint32_t(list.size()));
+        edge_count += list.size();
+        widest = std::max(widest, list.size());
+    }
+
+    // Decode count gaps from ctrl/data into absolute values in out, carrying
+    // the running value in prev. count must be a multiple of 4 unless it
+    // reaches the end of the list. Returns the new data position.
+    static const uint8_t* decode(const uint8_t* ctrl, const uint8_t* data,
+                                 size_t count, uint32_t& prev, uint32_t* out) {
+        size_t i = 0;
+#ifdef COMPRESSED_GRAPH_SSSE3
+        static const bool simd = __builtin_cpu_supports("ssse3");
+        if (simd) {
+            data = decode_ssse3(ctrl, data, count / 4, prev, out);
+            i = count / 4 * 4;
+        }
+#endif
+        for (; i < count; ++i) {
+            size_t len = ((ctrl[i / 4] >> (2 * (i % 4))) & 3) + 1;
+            uint32_t gap = 0;
+            for (size_t b = 0; b < len; ++b)
+                gap |= uint32_t(data[b]) << (8 * b);
+            data += len;
+            prev += gap;
+            out[i] = prev;
+        }
+        return data;
+    }
+
+#ifdef COMPRESSED_GRAPH_SSSE3
+    // Shuffle masks and data lengths for each of the 256 control bytes.
+    struct ssse3_tables {
+        uint8_t shuffle[256][16];
+        uint8_t length[256];
+
+        ssse3_tables() {
+            for (size_t c = 0; c < 256; ++c) {
+                uint8_t at = 0;
+                for (size_t j = 0; j < 4; ++j) {
+                    size_t len = ((c >> (2 * j)) & 3) + 1;
+                    for (size_t b = 0; b < 4; ++b)
+                        shuffle[c][4 * j + b] = b < len ? at + b : 0x80;
+                    at += len;
+                }
+                length[c] = at;
+            }
+        }
+    };
+
+    // Decode groups full groups of four: one shuffle widens the four gaps to
+    // 32 bits, two shifted adds turn them into a prefix sum.
+    __attribute__((target("ssse3")))
+    static const uint8_t* decode_ssse3(const uint8_t* ctrl,
+                                       const uint8_t* data, size_t groups,
+                                       uint32_t& prev, uint32_t* out) {
+        static const ssse3_tables t;
+        __m128i base = _mm_set1_epi32(int(prev));
+
+        for (size_t g = 0; g < groups; ++g) {
+            uint8_t c = ctrl[g];
+            __m128i v = _mm_shuffle_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(t.shuffle[c])));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, base);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * g), v);
+            base = _mm_shuffle_epi32(v, 0xFF);
+            data += t.length[c];
+        }
+
+        prev = uint32_t(_mm_cvtsi128_si32(base));
+        return data;
+    }
+#endif
+
+    std::vector<uint8_t> bytes;      // control and data bytes of every list
+    std::vector<uint64_t> offsets;   // n + 1 list offsets into bytes
+    std::vector<uint32_t> degrees;   // out-degree of each vertex
+    std::vector<size_t> desc;        // dense index -> descriptor, ascending
+    size_t edge_count;
+    size_t widest;
+};
+
+// BFS from dense vertex source over a compressed graph. On return p and d hold
+// the BFS-tree parent and hop distance of every vertex, with npos for
+// unreached vertices and for the parent of the source.
+inline void breadth_first_search(const compressed_graph& c, size_t source,
+                                 std::vector<size_t>& p,
+                                 std::vector<size_t>& d) {
+    p.assign(c.num_vertices(), compressed_graph::npos);
+    d.assign(c.num_vertices(), compressed_graph::npos);
+
+    std::queue<size_t> q;
+    d[source] = 0;
+    q.push(source);
+
+    while (!q.empty()) {
+        size_t v = q.front();
+        q.pop();
+        c.for_each_neighbor(v, [&](size_t u) {
+            if (d[u] == compressed_graph::npos) {
+                d[u] = d[v] + 1;
+                p[u] = v;
+                q.push(u);
+            }
+        });
+    }
+}
+
+// Weakly connected components of a compressed graph, by union-find over its
+// edges. On return component[v] is the component of dense vertex v, numbered
+// densely from 0 in order of first appearance. Returns the number of
+// components.
+inline size_t connected_components(const compressed_graph& c,
+                                   std::vector<size_t>& component) {
+    const size_t n = c.num_vertices();
+    std::vector<size_t> root(n);
+    for (size_t v = 0; v < n; ++v)
+        root[v] = v;
+
+    // path halving keeps the trees shallow without recursion
+    auto find = [&root](size_t v) {
+        while (root[v] != v) {
+            root[v] = root[root[v]];
+            v = root[v];
+        }
+        return v;
+    };
+
+    for (size_t v = 0; v < n; ++v) {
+        c.for_each_neighbor(v, [&](size_t u) {
+            size_t a = find(v), b = find(u);
+            if (a != b)
+                root[std::max(a, b)] = std::min(a, b);
+        });
+    }
+
+    size_t count = 0;
+    component.assign(n, compressed_graph::npos);
+    for (size_t v = 0; v < n; ++v) {
+        size_t r = find(v);
+        if (component[r] == compressed_graph::npos)
+            component[r] = count++;
+        component[v] = component[r];
+    }
+    return count;
+}
+
+#endif
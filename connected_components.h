@@ -0,0 +1,139 @@
+#ifndef _CONNECTED_COMPONENTS_H_
+#define _CONNECTED_COMPONENTS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "csr_graph.h"
+#include "scheduler.h"
+
+// Parallel connected components (Afforest).
+//
+// Every vertex starts as its own component in a shared array of parent
+// pointers, and edges are merged into it with a lock-free union-find: a link
+// only ever points a root at a smaller root, with a compare-and-swap. First a
+// few sampled neighbors per vertex are linked, which in most graphs already
+// gathers the bulk of the vertices into one giant component. The remaining
+// edges are then linked, skipping every vertex already in that component.
+// On graphs with a giant component this touches a small fraction of the
+// edges.
+//
+// Components are weak: edge direction is ignored.
+
+// Link the components of u and v.
+inline void afforest_link(std::vector<std::atomic<size_t> >& comp,
+                          size_t u, size_t v) {
+    size_t a = comp[u].load(std::memory_order_relaxed);
+    size_t b = comp[v].load(std::memory_order_relaxed);
+    while (a != b) {
+        size_t high = a > b ? a : b;
+        size_t low = a + b - high;
+        size_t parent = comp[high].load(std::memory_order_relaxed);
+        if (parent == low)
+            return;
+        if (parent == high &&
+            comp[high].compare_exchange_strong(parent, low))
+            return;
+        // high was linked elsewhere meanwhile; climb and retry
+        a = comp[comp[high].load(std::memory_order_relaxed)]
+                .load(std::memory_order_relaxed);
+        b = comp[low].load(std::memory_order_relaxed);
+    }
+}
+
+// Point every vertex in [begin, end) directly at its root.
+inline void afforest_compress(std::vector<std::atomic<size_t> >& comp,
+                              size_t begin, size_t end) {
+    for (size_t v = begin; v < end; ++v) {
+        size_t p = comp[v].load(std::memory_order_relaxed);
+        size_t gp = comp[p].load(std::memory_order_relaxed);
+        while (p != gp) {
+            comp[v].store(gp, std::memory_order_relaxed);
+            p = gp;
+            gp = comp[p].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Weakly connected components of a CSR snapshot on threads threads (0 uses
+// every core). On return component[v] is the component of dense vertex v,
+// numbered densely from 0 in order of first appearance. Returns the number of
+// components.
+template<typename Graph>
+size_t connected_components(const csr_graph<Graph>& c,
+                            std::vector<size_t>& component,
+                            size_t threads = 0) {
+    const size_t n = c.num_vertices();
+    const size_t sampled = 2;
+
+    // in-neighbors too, so that skipping the giant component's lists loses
+    // no edge: each edge is also listed at its other end
+    csr_graph<Graph> t = c.transpose();
+    auto neighbor = [&c, &t](size_t v, size_t i) {
+        return i < c.degree(v) ? c.neighbors_begin(v)[i] :
+                                 t.neighbors_begin(v)[i - c.degree(v)];
+    };
+
+    std::vector<std::atomic<size_t> > comp(n);
+    parallel_for(0, n, 1024, [&comp](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v)
+            comp[v].store(v, std::memory_order_relaxed);
+    }, threads);
+
+    for (size_t r = 0; r < sampled; ++r) {
+        parallel_for(0, n, 1024, [&](size_t begin, size_t end) {
+            for (size_t v = begin; v < end; ++v)
+                if (r < c.degree(v) + t.degree(v))
+                    afforest_link(comp, v, neighbor(v, r));
+        }, threads);
+        parallel_for(0, n, 1024, [&comp](size_t begin, size_t end) {
+            afforest_compress(comp, begin, end);
+        }, threads);
+    }
+
+    // guess the giant component from a fixed pseudo-random sample
+    size_t giant = n;
+    if (n != 0) {
+        std::unordered_map<size_t, size_t> count;
+        size_t most = 0;
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        for (size_t i = 0; i < 1024; ++i) {
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+            size_t root = comp[(x >> 33) % n].load(std::memory_order_relaxed);
+            if (++count[root] > most) {
+                most = count[root];
+                giant = root;
+            }
+        }
+    }
+
+    parallel_for(0, n, 1024, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            if (comp[v].load(std::memory_order_relaxed) == giant)
+                continue;
+            for (size_t i = sampled; i < c.degree(v) + t.degree(v); ++i)
+                afforest_link(comp, v, neighbor(v, i));
+        }
+    }, threads);
+    parallel_for(0, n, 1024, [&comp](size_t begin, size_t end) {
+        afforest_compress(comp, begin, end);
+    }, threads);
+
+    // roots are the smallest vertex of their component, so numbering in
+    // vertex order always meets the root first
+    size_t components = 0;
+    component.assign(n, csr_graph<Graph>::npos);
+    for (size_t v = 0; v < n; ++v) {
+        size_t root = comp[v].load(std::memory_order_relaxed);
+        if (root == v)
+            component[v] = components++;
+        else
+            component[v] = component[root];
+    }
+    return components;
+}
+
+#endif
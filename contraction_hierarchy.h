@@ -0,0 +1,630 @@
+#ifndef _CONTRACTION_HIERARCHY_H_
+#define _CONTRACTION_HIERARCHY_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// A contraction hierarchy over a static graph, for fast point-to-point
+/// shortest path queries.
+///
+/// Preprocessing contracts the vertices one at a time, in order of increasing
+/// importance. Contracting v removes it from the remaining graph. For every
+/// path u -> v -> w through it that is the only shortest u -> w path, a
+/// shortcut edge u -> w is added. A bounded Dijkstra's from u that avoids v,
+/// the witness search, decides whether another path is as short. Importance
+/// is the edge difference (shortcuts added minus edges removed) plus the
+/// number of neighbors already contracted. It is updated lazily as the graph
+/// shrinks.
+///
+/// A query runs Dijkstra's forward from s and backward from t, both only
+/// along edges toward more important vertices. Shortcuts are unpacked into
+/// original edges afterwards. The hierarchy can be saved and loaded, so the
+/// preprocessing only has to run once per graph. Edge weights must be
+/// non-negative, and the edge property type must be trivially copyable to be
+/// saved.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Graph>
+class contraction_hierarchy {
+
+  public:
+
+    typedef typename Graph::vertex_descriptor vertex_descriptor;
+    typedef typename Graph::edge_property weight;
+
+    contraction_hierarchy() : epoch(0) {}
+
+    explicit contraction_hierarchy(const Graph& g) : epoch(0) {build(g);}
+
+    /// Preprocess g, replacing any previous hierarchy.
+    void build(const Graph& g) {
+        csr_graph<Graph> c(g);
+        const size_t n = c.num_vertices();
+
+        desc.resize(n);
+        for (size_t v = 0; v < n; ++v)
+            desc[v] = c.descriptor(v);
+
+        // the remaining graph, which shrinks as vertices are contracted
+        std::vector<std::vector<arc> > out(n), in(n);
+        for (size_t v = 0; v < n; ++v) {
+            const weight* w = c.weights_begin(v);
+            for (const size_t* u = c.neighbors_begin(v);
+                 u != c.neighbors_end(v); ++u, ++w)
+                if (*u != v)
+                    add_arc(out, in, v, *u, *w, npos);
+        }
+
+        std::vector<std::vector<arc> > up_out(n), up_in(n);
+        std::vector<size_t> contracted_neighbors(n, 0);
+        std::vector<bool> contracted(n, false);
+        begin_search(n);
+
+        typedef std::pair<long, size_t> entry;
+        std::priority_queue<entry, std::vector<entry>, std::greater<entry> > q;
+        std::vector<shortcut> shortcuts;
+        for (size_t v = 0; v < n; ++v)
+            q.push(entry(priority(out, in, v, contracted_neighbors, shortcuts),
+                         v));
+
+        while (!q.empty()) {
+            size_t v = q.top().second;
+            q.pop();
+            if (contracted[v])
+                continue;
+
+            // lazy update: recompute, and put v back if it is no longer the
+            // least important
+            long p = priority(out, in, v, contracted_neighbors, shortcuts);
+            if (!q.empty() && p > q.top().first) {
+                q.push(entry(p, v));
+                continue;
+            }
+
+            contracted[v] = true;
+
+            // whatever is still attached to v is more important than v, so
+            // these become v's upward edges
+            up_out[v] = out[v];
+            up_in[v] = in[v];
+
+            for (size_t i = 0; i < out[v].size(); ++i) {
+                remove_arc(in[out[v][i].to], v);
+                ++contracted_neighbors[out[v][i].to];
+            }
+            for (size_t i = 0; i < in[v].size(); ++i) {
+                remove_arc(out[in[v][i].to], v);
+                ++contracted_neighbors[in[v][i].to];
+            }
+
+            // shortcuts come from the witness searches run by priority()
+            for (size_t i = 0; i < shortcuts.size(); ++i)
+                add_arc(out, in, shortcuts[i].from, shortcuts[i].to,
+                        shortcuts[i].dist, v);
+
+            std::vector<arc>().swap(out[v]);
+            std::vector<arc>().swap(in[v]);
+        }
+
+        to_csr(up_out, fwd);
+        to_csr(up_in, bwd);
+        begin_search(n);
+    }
+
+    size_t num_vertices() const {return desc.size();}
+
+    /// Number of edges in the hierarchy, original and shortcut.
+    size_t num_edges() const {return fwd.to.size() + bwd.to.size();}
+
+    /// Number of shortcut edges added by preprocessing.
+    size_t num_shortcuts() const {
+        size_t count = 0;
+        for (size_t i = 0; i < fwd.middle.size(); ++i)
+            count += fwd.middle[i] != npos;
+        for (size_t i = 0; i < bwd.middle.size(); ++i)
+            count += bwd.middle[i] != npos;
+        return count;
+    }
+
+    /// Shortest path from s to t. Returns false if t is unreachable, or if
+    /// a shortcut on the path cannot be unpacked; otherwise sets dist and
+    /// fills path with the vertices from s to t in the original graph.
+    bool query(vertex_descriptor s, vertex_descriptor t, weight& dist,
+               std::vector<vertex_descriptor>& path) {
+        size_t src = index(s), dst = index(t);
+        path.clear();
+        if (src == npos || dst == npos)
+            return false;
+        begin_search(desc.size());
+
+        heap q[2];
+        reach(0, src, weight(0), npos);
+        reach(1, dst, weight(0), npos);
+        q[0].push(entry(weight(0), src));
+        q[1].push(entry(weight(0), dst));
+
+        const upward* side[2] = {&fwd, &bwd};
+        bool found = false;
+        weight best = weight(0);
+        size_t meet = npos;
+
+        // each side may stop once its smallest key can no longer improve
+        // the best path
+        while (!q[0].empty() || !q[1].empty()) {
+            int dir = q[0].empty() ? 1 : q[1].empty() ? 0 :
+                      q[1].top().first < q[0].top().first ? 1 : 0;
+            entry top = q[dir].top();
+            q[dir].pop();
+            if (found && !(top.first < best)) {
+                q[dir] = heap();
+                continue;
+            }
+            if (distance(dir, top.second) < top.first)
+                continue;
+
+            size_t v = top.second;
+            if (reached(1 - dir, v)) {
+                weight through = top.first + distance(1 - dir, v);
+                if (!found || through < best) {
+                    found = true;
+                    best = through;
+                    meet = v;
+                }
+            }
+
+            const upward& u = *side[dir];
+            for (size_t e = u.offsets[v]; e < u.offsets[v + 1]; ++e) {
+                weight nd = top.first + u.dist[e];
+                if (!reached(dir, u.to[e]) || nd < distance(dir, u.to[e])) {
+                    reach(dir, u.to[e], nd, e);
+                    q[dir].push(entry(nd, u.to[e]));
+                }
+            }
+        }
+
+        if (!found)
+            return false;
+
+        dist = best;
+
+        // walk both search trees back from the meeting vertex, unpacking
+        // each edge of the hierarchy into original edges
+        std::vector<size_t> dense(1, meet);
+        for (size_t v = meet; search[0][v].edge != npos; ) {
+            size_t e = search[0][v].edge;
+            size_t from = fwd_source(e);
+            std::vector<size_t> piece(1, from);
+            if (!unpack(from, v, fwd.middle[e], piece)) {
+                path.clear();
+                return false;
+            }
+            dense.insert(dense.begin(), piece.begin(), piece.end() - 1);
+            v = from;
+        }
+        for (size_t v = meet; search[1][v].edge != npos; ) {
+            size_t e = search[1][v].edge;
+            size_t to = bwd_source(e);
+            std::vector<size_t> piece(1, v);
+            if (!unpack(v, to, bwd.middle[e], piece)) {
+                path.clear();
+                return false;
+            }
+            dense.insert(dense.end(), piece.begin() + 1, piece.end());
+            v = to;
+        }
+
+        for (size_t i = 0; i < dense.size(); ++i)
+            path.push_back(desc[dense[i]]);
+        return true;
+    }
+
+    /// Write the hierarchy to os in a binary format. Returns false on error.
+    bool save(std::ostream& os) const {
+        uint64_t n = desc.size();
+        os.write(magic, sizeof(magic));
+        os.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        write_vector(os, desc);
+        save_upward(os, fwd);
+        save_upward(os, bwd);
+        return bool(os);
+    }
+
+    /// Replace the hierarchy with one written by save(). Returns false, and
+    /// leaves the hierarchy empty, if is does not hold a valid one. Counts,
+    /// offsets and shortcuts are checked, so a truncated or corrupt stream
+    /// is rejected rather than read out of bounds or unpacked forever.
+    bool load(std::istream& is) {
+        char m[sizeof(magic)];
+        uint64_t n = 0;
+        is.read(m, sizeof(m));
+        is.read(reinterpret_cast<char*>(&n), sizeof(n));
+        bool ok = is && std::equal(m, m + sizeof(m), magic) &&
+                  read_vector(is, desc, n) &&
+                  load_upward(is, fwd, n) && load_upward(is, bwd, n) &&
+                  shortcuts_unpack();
+        if (!ok) {
+            desc.clear();
+            fwd = upward();
+            bwd = upward();
+        }
+        begin_search(desc.size());
+        return ok;
+    }
+
+  private:
+
+    static const size_t npos = size_t(-1);
+    static const char magic[8];
+
+    // An edge of the working graph; middle is npos for an original edge and
+    // the contracted vertex for a shortcut.
+    struct arc {
+        size_t to;
+        weight dist;
+        size_t middle;
+    };
+
+    // A shortcut that contracting the current vertex would add.
+    struct shortcut {
+        size_t from;
+        size_t to;
+        weight dist;
+    };
+
+    // Upward edges in CSR form. In fwd, the edges of v lead from v to more
+    // important vertices; in bwd, they lead into v from more important
+    // vertices, with to holding the other end.
+    struct upward {
+        std::vector<size_t> offsets;
+        std::vector<size_t> to;
+        std::vector<weight> dist;
+        std::vector<size_t> middle;
+    };
+
+    // Per-vertex search state, stamped with the search that wrote it so a new
+    // search does not have to clear the arrays.
+    struct label {
+        weight dist = weight(0);
+        size_t edge = 0;
+        uint32_t stamp = 0;
+    };
+
+    typedef std::pair<weight, size_t> entry;
+    typedef std::priority_queue<entry, std::vector<entry>,
+                                std::greater<entry> > heap;
+
+    // Witness searches give up after settling this many vertices and then
+    // assume no witness exists, which can only add superfluous shortcuts.
+    static const size_t witness_limit = 500;
+
+    size_t index(vertex_descriptor vd) const {
+        auto i = std::lower_bound(desc.begin(), desc.end(), vd);
+        return i != desc.end() && *i == vd ? size_t(i - desc.begin()) : npos;
+    }
+
+    // Add u -> w to the working graph, keeping only the lighter of two
+    // parallel edges.
+    static void add_arc(std::vector<std::vector<arc> >& out,
+                        std::vector<std::vector<arc> >& in,
+                        size_t u, size_t w, weight d, size_t middle) {
+        for (size_t i = 0; i < out[u].size(); ++i) {
+            if (out[u][i].to != w)
+                continue;
+            if (d < out[u][i].dist) {
+                out[u][i].dist = d;
+                out[u][i].middle = middle;
+                for (size_t j = 0; j < in[w].size(); ++j) {
+                    if (in[w][j].to == u) {
+                        in[w][j].dist = d;
+                        in[w][j].middle = middle;
+                    }
+                }
+            }
+            return;
+        }
+        arc a = {w, d, middle};
+        out[u].push_back(a);
+        arc b = {u, d, middle};
+        in[w].push_back(b);
+    }
+
+    static void remove_arc(std::vector<arc>& list, size_t to) {
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (list[i].to == to) {
+                list[i] = list.back();
+                list.pop_back();
+                return;
+            }
+        }
+    }
+
+    // Importance of v in the current working graph. Leaves the shortcuts
+    // that contracting v would need in shortcuts.
+    long priority(const std::vector<std::vector<arc> >& out,
+                  const std::vector<std::vector<arc> >& in, size_t v,
+                  const std::vector<size_t>& contracted_neighbors,
+                  std::vector<shortcut>& shortcuts) {
+        shortcuts.clear();
+        for (size_t i = 0; i < in[v].size(); ++i) {
+            size_t u = in[v][i].to;
+
+            weight limit = weight(0);
+            for (size_t j = 0; j < out[v].size(); ++j)
+                if (out[v][j].to != u)
+                    limit = std::max(limit, in[v][i].dist + out[v][j].dist);
+
+            witness_search(out, u, v, limit);
+
+            for (size_t j = 0; j < out[v].size(); ++j) {
+                size_t w = out[v][j].to;
+                if (w == u)
+                    continue;
+                weight through = in[v][i].dist + out[v][j].dist;
+                if (!reached(0, w) || through < distance(0, w)) {
+                    shortcut s = {u, w, through};
+                    shortcuts.push_back(s);
+                }
+            }
+        }
+
+        return long(shortcuts.size()) - long(in[v].size() + out[v].size()) +
+               long(contracted_neighbors[v]);
+    }
+
+    // Dijkstra's from u in the working graph without v, up to distance limit.
+    void witness_search(const std::vector<std::vector<arc> >& out,
+                        size_t u, size_t v, weight limit) {
+        begin_search(out.size());
+        heap q;
+        reach(0, u, weight(0), npos);
+        q.push(entry(weight(0), u));
+
+        for (size_t settled = 0; !q.empty() && settled < witness_limit; ) {
+            entry top = q.top();
+            q.pop();
+            if (distance(0, top.second) < top.first)
+                continue;
+            if (limit < top.first)
+                break;
+            ++settled;
+
+            const std::vector<arc>& a = out[top.second];
+            for (size_t i = 0; i < a.size(); ++i) {
+                if (a[i].to == v)
+                    continue;
+                weight nd = top.first + a[i].dist;
+                if (!reached(0, a[i].to) || nd < distance(0, a[i].to)) {
+                    reach(0, a[i].to, nd, npos);
+                    q.push(entry(nd, a[i].to));
+                }
+            }
+        }
+    }
+
+    static void to_csr(const std::vector<std::vector<arc> >& lists,
+                       upward& u) {
+        u = upward();
+        u.offsets.push_back(0);
+        for (size_t v = 0; v < lists.size(); ++v) {
+            for (size_t i = 0; i < lists[v].size(); ++i) {
+                u.to.push_back(lists[v][i].to);
+                u.dist.push_back(lists[v][i].dist);
+                u.middle.push_back(lists[v][i].middle);
+            }
+            u.offsets.push_back(u.to.size());
+        }
+    }
+
+    // Vertex whose fwd list holds edge e, and likewise for bwd.
+    size_t fwd_source(size_t e) const {
+        return std::upper_bound(fwd.offsets.begin(), fwd.offsets.end(), e) -
+               fwd.offsets.begin() - 1;
+    }
+    size_t bwd_source(size_t e) const {
+        return std::upper_bound(bwd.offsets.begin(), bwd.offsets.end(), e) -
+               bwd.offsets.begin() - 1;
+    }
+
+    // Append the vertices strictly after a on the original path behind the
+    // hierarchy edge a -> b with the given middle vertex. Returns false if
+    // an edge it needs is missing.
+    bool unpack(size_t a, size_t b, size_t middle,
+                std::vector<size_t>& path) const {
+        if (middle == npos) {
+            path.push_back(b);
+            return true;
+        }
+        // middle was contracted before a and b, so a -> middle is an
+        // incoming upward edge of middle and middle -> b an outgoing one
+        size_t first, second;
+        return find_middle(bwd, middle, a, first) &&
+               unpack(a, middle, first, path) &&
+               find_middle(fwd, middle, b, second) &&
+               unpack(middle, b, second, path);
+    }
+
+    // The middle vertex of the upward edge of v that leads to to. Returns
+    // false if v has no such edge.
+    static bool find_middle(const upward& u, size_t v, size_t to,
+                            size_t& middle) {
+        for (size_t e = u.offsets[v]; e < u.offsets[v + 1]; ++e)
+            if (u.to[e] == to) {
+                middle = u.middle[e];
+                return true;
+            }
+        return false;
+    }
+
+    // Whether every shortcut of a loaded hierarchy can be unpacked: upward
+    // edges never lead around a cycle, so the vertices can be ranked, and
+    // each shortcut a -> b through m has m ranked below a and b and both
+    // edges a -> m and m -> b present. Unpacking then ends, since every
+    // step moves to a pair whose lower end ranks lower.
+    bool shortcuts_unpack() const {
+        const size_t n = desc.size();
+        const upward* side[2] = {&fwd, &bwd};
+
+        // rank by Kahn's algorithm over the edges from each vertex to the
+        // more important ends of its upward edges
+        std::vector<size_t> above(n, 0), rank(n, npos), ready;
+        for (int dir = 0; dir < 2; ++dir)
+            for (size_t e = 0; e < side[dir]->to.size(); ++e)
+                ++above[side[dir]->to[e]];
+        for (size_t v = 0; v < n; ++v)
+            if (above[v] == 0)
+                ready.push_back(v);
+        size_t ranked = 0;
+        while (!ready.empty()) {
+            size_t v = ready.back();
+            ready.pop_back();
+            rank[v] = ranked++;
+            for (int dir = 0; dir < 2; ++dir) {
+                const upward& u = *side[dir];
+                for (size_t e = u.offsets[v]; e < u.offsets[v + 1]; ++e)
+                    if (--above[u.to[e]] == 0)
+                        ready.push_back(u.to[e]);
+            }
+        }
+        if (ranked != n)
+            return false;
+
+        size_t middle;
+        for (int dir = 0; dir < 2; ++dir) {
+            const upward& u = *side[dir];
+            for (size_t v = 0; v < n; ++v)
+                for (size_t e = u.offsets[v]; e < u.offsets[v + 1]; ++e) {
+                    size_t m = u.middle[e];
+                    if (m == npos)
+                        continue;
+                    // fwd edges lead v -> to, bwd edges to -> v
+                    size_t a = dir == 0 ? v : u.to[e];
+                    size_t b = dir == 0 ? u.to[e] : v;
+                    if (rank[m] >= rank[a] || rank[m] >= rank[b] ||
+                        !find_middle(bwd, m, a, middle) ||
+                        !find_middle(fwd, m, b, middle))
+                        return false;
+                }
+        }
+        return true;
+    }
+
+    void begin_search(size_t n) {
+        for (int dir = 0; dir < 2; ++dir)
+            if (search[dir].size() != n)
+                search[dir].assign(n, label());
+        if (++epoch == 0) {
+            // the counter wrapped; old stamps could look current again
+            for (int dir = 0; dir < 2; ++dir)
+                std::fill(search[dir].begin(), search[dir].end(), label());
+            epoch = 1;
+        }
+    }
+
+    bool reached(int dir, size_t v) const {
+        return search[dir][v].stamp == epoch;
+    }
+
+    weight distance(int dir, size_t v) const {
+        return reached(dir, v) ? search[dir][v].dist :
+                                 std::numeric_limits<weight>::max();
+    }
+
+    void reach(int dir, size_t v, weight d, size_t edge) {
+        label& l = search[dir][v];
+        l.dist = d;
+        l.edge = edge;
+        l.stamp = epoch;
+    }
+
+    template<typename T>
+    static void write_vector(std::ostream& os, const std::vector<T>& v) {
+        os.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    }
+
+    // Bytes left to read in is, or npos if the stream cannot seek.
+    static size_t bytes_left(std::istream& is) {
+        std::streampos at = is.tellg();
+        if (at == std::streampos(-1))
+            return npos;
+        is.seekg(0, std::ios::end);
+        std::streampos end = is.tellg();
+        is.seekg(at);
+        return end == std::streampos(-1) || end < at ? npos :
+                                                       size_t(end - at);
+    }
+
+    // Read n values into v. A count larger than the stream fails the read
+    // rather than the allocation: it is checked against the bytes left, and
+    // streams that cannot seek are read a chunk at a time, so v never grows
+    // far past what the stream actually holds.
+    template<typename T>
+    static bool read_vector(std::istream& is, std::vector<T>& v, size_t n) {
+        size_t left = bytes_left(is);
+        if (left != npos && n > left / sizeof(T))
+            return false;
+        const size_t chunk = ((1 << 20) + sizeof(T) - 1) / sizeof(T);
+        v.clear();
+        while (is && v.size() < n) {
+            size_t at = v.size();
+            v.resize(at + std::min(chunk, n - at));
+            is.read(reinterpret_cast<char*>(v.data() + at),
+                    (v.size() - at) * sizeof(T));
+        }
+        return bool(is);
+    }
+
+    static void save_upward(std::ostream& os, const upward& u) {
+        uint64_t m = u.to.size();
+        os.write(reinterpret_cast<const char*>(&m), sizeof(m));
+        write_vector(os, u.offsets);
+        write_vector(os, u.to);
+        write_vector(os, u.dist);
+        write_vector(os, u.middle);
+    }
+
+    // Read one upward CSR, checking that it is well formed: offsets start at
+    // 0, never decrease and end at m, and every edge leads to a vertex, and
+    // through one if it is a shortcut, below n.
+    static bool load_upward(std::istream& is, upward& u, size_t n) {
+        uint64_t m = 0;
+        is.read(reinterpret_cast<char*>(&m), sizeof(m));
+        if (!is || !read_vector(is, u.offsets, n + 1) || u.offsets[0] != 0 ||
+            u.offsets[n] != m || !read_vector(is, u.to, m) ||
+            !read_vector(is, u.dist, m) || !read_vector(is, u.middle, m))
+            return false;
+        for (size_t v = 0; v < n; ++v)
+            if (u.offsets[v] > u.offsets[v + 1])
+                return false;
+        for (size_t e = 0; e < m; ++e)
+            if (u.to[e] >= n || (u.middle[e] != npos && u.middle[e] >= n))
+                return false;
+        return true;
+    }
+
+    std::vector<vertex_descriptor> desc;  // dense index -> descriptor
+    upward fwd;                           // upward out-edges
+    upward bwd;                           // upward in-edges
+    std::vector<label> search[2];         // forward and backward search state
+    uint32_t epoch;
+};
+
+template<typename Graph>
+const size_t contraction_hierarchy<Graph>::npos;
+
+template<typename Graph>
+const size_t contraction_hierarchy<Graph>::witness_limit;
+
+template<typename Graph>
+const char contraction_hierarchy<Graph>::magic[8] =
+    {'G', 'R', 'A', 'P', 'H', 'C', 'H', '1'};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef _CSR_GRAPH_H_
+#define _CSR_GRAPH_H_
+
+#include <cstddef>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+/// A read-only compressed sparse row (CSR) snapshot of a graph's out-edges.
+///
+/// Vertices are renumbered densely into [0, n) in descriptor order, so an
+/// algorithm can keep its per-vertex state in plain arrays and walk each
+/// neighbor list as one contiguous run instead of chasing map nodes. The
+/// snapshot does not track later changes to the graph it was built from.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Graph>
+class csr_graph {
+
+  public:
+
+    typedef typename Graph::vertex_descriptor vertex_descriptor;
+    typedef typename Graph::edge_property edge_property;
+
+    /// Marker for "no such vertex" in index() and in dense result arrays
+    static const size_t npos = size_t(-1);
+
+    explicit csr_graph(const Graph& g) {
+        // descriptors come from the graph's counter, so the largest one bounds
+        // the size of a direct descriptor -> index table
+        size_t max_desc = 0;
+        if (g.num_vertices() != 0) {
+            auto last = g.vertices_cend();
+            --last;
+            max_desc = last->first;
+        }
+        idx.assign(g.num_vertices() == 0 ? 0 : max_desc + 1, npos);
+        desc.reserve(g.num_vertices());
+
+        for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v) {
+            idx[v->first] = desc.size();
+            desc.push_back(v->first);
+        }
+
+        offsets.reserve(desc.size() + 1);
+        targets.reserve(g.num_edges());
+        weights.reserve(g.num_edges());
+        offsets.push_back(0);
+
+        for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v) {
+            // adjacency maps hold both in- and out-edges; keep the out-edges,
+            // which come out sorted by target because of the map's key order
+            for (auto e = v->second->cbegin(); e != v->second->cend(); ++e) {
+                if (e->second->source() == v->first) {
+                    targets.push_back(idx[e->second->target()]);
+                    weights.push_back(e->second->property());
+                }
+            }
+            offsets.push_back(targets.size());
+        }
+    }
+
+    size_t num_vertices() const {return desc.size();}
+    size_t num_edges() const {return targets.size();}
+
+    // dense index of a descriptor, or npos if it is not in the snapshot
+    size_t index(vertex_descriptor vd) const {
+        return vd < idx.size() ? idx[vd] : npos;
+    }
+
+    // descriptor of a dense index
+    vertex_descriptor descriptor(size_t i) const {return desc[i];}
+
+    size_t degree(size_t i) const {return offsets[i + 1] - offsets[i];}
+
+    // out-neighbors of dense vertex i, as dense indices
+    const size_t* neighbors_begin(size_t i) const {
+        return targets.data() + offsets[i];
+    }
+    const size_t* neighbors_end(size_t i) const {
+        return targets.data() + offsets[i + 1];
+    }
+
+    // edge properties parallel to neighbors_begin(i)..neighbors_end(i)
+    const edge_property* weights_begin(size_t i) const {
+        return weights.data() + offsets[i];
+    }
+
+    // build the snapshot of the reversed graph, so neighbor lists become
+    // in-neighbor lists; descriptors and dense indices are unchanged
+    csr_graph transpose() const {
+        csr_graph t;
+        t.desc = desc;
+        t.idx = idx;
+        t.offsets.assign(desc.size() + 1, 0);
+        t.targets.resize(targets.size());
+        t.weights.resize(weights.size());
+
+        for (size_t e = 0; e < targets.size(); ++e)
+            ++t.offsets[targets[e] + 1];
+        for (size_t i = 0; i < desc.size(); ++i)
+            t.offsets[i + 1] += t.offsets[i];
+
+        // scattering sources in increasing order keeps every reversed list
+        // sorted as well
+        std::vector<size_t> next(t.offsets.begin(), t.offsets.end() - 1);
+        for (size_t u = 0; u < desc.size(); ++u) {
+            for (size_t e = offsets[u]; e < offsets[u + 1]; ++e) {
+                size_t slot = next[targets[e]]++;
+                t.targets[slot] = u;
+                t.weights[slot] = weights[e];
+            }
+        }
+        return t;
+    }
+
+  private:
+
+    csr_graph() {}
+
+    std::vector<vertex_descriptor> desc;  // dense index -> descriptor
+    std::vector<size_t> idx;              // descriptor -> dense index
+    std::vector<size_t> offsets;          // n + 1 row offsets into targets
+    std::vector<size_t> targets;          // concatenated neighbor lists
+    std::vector<edge_property> weights;   // edge properties, parallel to targets
+};
+
+template<typename Graph>
+const size_t csr_graph<Graph>::npos;
+
+#endif
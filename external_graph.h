@@ -0,0 +1,387 @@
+#ifndef _EXTERNAL_GRAPH_H_
+#define _EXTERNAL_GRAPH_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csr_graph.h"
+
+// Semi-external BFS and connected components over an edge file on disk.
+//
+// Only per-vertex state is kept in memory: a few words per vertex for the
+// BFS depths, parents and run index, or the union-find parents. The edges
+// stay on disk and are streamed in large sequential blocks with pread, with
+// the kernel asked to read the next block ahead while the current one is
+// processed. Connected components is a single pass over the file. BFS makes
+// one pass per level, but reads only the runs of the vertices on the
+// frontier, merging runs that lie close together into one read, so small
+// frontiers cost little and a large one degenerates into a sequential scan.
+//
+// An edge file is a header followed by (source, target) pairs of 32-bit
+// dense vertex indices, sorted by source. edge_file_writer writes one from
+// edges appended in order, and write_edge_file writes a CSR snapshot.
+//
+// To try it on a file larger than memory, generate one with time_graph's
+// fourth argument, the edge count, and cap the memory of the run. For
+// instance, 600000000 edges make a 4.5 GB file over 75 million vertices.
+// BFS keeps 24 bytes per vertex for the depths, parents and runs, 1.8 GB,
+// and the frontier and next level 8 bytes per vertex they hold. A level
+// can hold nearly every vertex, and with vector growth that is up to 16
+// bytes per vertex, another 1.2 GB. With the 16 MB read buffer that is
+// about 3 GB, so the run fits under
+//
+//   systemd-run --user --scope -p MemoryMax=4G ./time_graph.o ...
+//
+// A cgroup cap also covers the page cache, unlike ulimit -v, which caps only
+// address space; pread keeps the file out of the address space either way.
+// Linux only, like sharded_sssp.
+
+/// The header at the start of an edge file.
+struct edge_file_header {
+    char     magic[8];          ///< "G221EDGE"
+    uint64_t vertices;
+    uint64_t edges;
+};
+
+/// One edge of an edge file.
+struct edge_record {
+    uint32_t source;
+    uint32_t target;
+};
+
+const char edge_file_magic[8] = {'G', '2', '2', '1', 'E', 'D', 'G', 'E'};
+
+inline bool edge_file_write(int fd, const void* buf, size_t len) {
+    const char* p = static_cast<const char*>(buf);
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w <= 0)
+            return false;
+        p += w;
+        len -= w;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Writes an edge file. Edges must be appended in order of source, and the
+/// header is filled in by close().
+////////////////////////////////////////////////////////////////////////////////
+class edge_file_writer {
+
+  public:
+
+    edge_file_writer(const std::string& path, size_t vertices) :
+        fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+        vertices(vertices), edges(0), last(0), good(fd >= 0) {
+        // leave room for the header
+        edge_file_header h = edge_file_header();
+        good = good && edge_file_write(fd, &h, sizeof(h));
+    }
+
+    ~edge_file_writer() {close();}
+
+    edge_file_writer(const edge_file_writer&) = delete;
+    edge_file_writer& operator=(const edge_file_writer&) = delete;
+
+    bool ok() const {return good;}
+
+    /// Append the edge source -> target. Returns false, and fails the file,
+    /// when a vertex is out of range or source is smaller than the last one.
+    bool append(size_t source, size_t target) {
+        if (!good || source >= vertices || target >= vertices ||
+            source < last)
+            return good = false;
+        buffer.push_back(edge_record{uint32_t(source), uint32_t(target)});
+        last = source;
+        ++edges;
+        if (buffer.size() * sizeof(edge_record) >= (1 << 20))
+            flush();
+        return good;
+    }
+
+    /// Write out the rest of the edges and the header. Returns whether the
+    /// whole file was written.
+    bool close() {
+        if (fd < 0)
+            return good;
+        flush();
+        edge_file_header h;
+        std::memcpy(h.magic, edge_file_magic, sizeof(h.magic));
+        h.vertices = vertices;
+        h.edges = edges;
+        good = good && pwrite(fd, &h, sizeof(h), 0) == ssize_t(sizeof(h));
+        good = ::close(fd) == 0 && good;
+        fd = -1;
+        return good;
+    }
+
+  private:
+
+    void flush() {
+        good = good && edge_file_write(fd, buffer.data(),
+                                       buffer.size() * sizeof(edge_record));
+        buffer.clear();
+    }
+
+    int fd;
+    uint64_t vertices;
+    uint64_t edges;
+    uint64_t last;              // source of the last edge appended
+    bool good;
+    std::vector<edge_record> buffer;
+};
+
+// Write the edges of a CSR snapshot, by dense index, to an edge file.
+// Returns whether the whole file was written.
+template<typename Graph>
+bool write_edge_file(const csr_graph<Graph>& c, const std::string& path) {
+    if (c.num_vertices() > uint32_t(-1))
+        return false;
+    edge_file_writer w(path, c.num_vertices());
+    for (size_t v = 0; v < c.num_vertices(); ++v)
+        for (const size_t* u = c.neighbors_begin(v); u != c.neighbors_end(v);
+             ++u)
+            w.append(v, *u);
+    return w.close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// A read-only edge file. Edges are read in blocks of block_bytes.
+////////////////////////////////////////////////////////////////////////////////
+class edge_file {
+
+  public:
+
+    static const size_t npos = size_t(-1);
+
+    explicit edge_file(const std::string& path,
+                       size_t block_bytes = 16 << 20) :
+        fd(open(path.c_str(), O_RDONLY)), vertices(0), edges(0),
+        block(std::max<size_t>(1, block_bytes / sizeof(edge_record))),
+        read_bytes(0) {
+        edge_file_header h;
+        struct stat st;
+        // check the counts against the limits before multiplying them, so
+        // a corrupt header cannot overflow its way to a matching size
+        if (fd >= 0 && pread(fd, &h, sizeof(h), 0) == ssize_t(sizeof(h)) &&
+            std::memcmp(h.magic, edge_file_magic, sizeof(h.magic)) == 0 &&
+            fstat(fd, &st) == 0 && uint64_t(st.st_size) >= sizeof(h) &&
+            h.vertices <= uint64_t(1) << 32 &&
+            h.edges <= (uint64_t(st.st_size) - sizeof(h)) /
+                           sizeof(edge_record) &&
+            uint64_t(st.st_size) == sizeof(h) + h.edges * sizeof(edge_record)) {
+            vertices = h.vertices;
+            edges = h.edges;
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        } else if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    ~edge_file() {
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    edge_file(const edge_file&) = delete;
+    edge_file& operator=(const edge_file&) = delete;
+
+    /// Whether the file opened and its header matches its size, with
+    /// vertices that fit 32-bit indices.
+    bool ok() const {return fd >= 0;}
+
+    size_t num_vertices() const {return vertices;}
+    size_t num_edges() const {return edges;}
+
+    /// Edge bytes read from the file so far, by every scan.
+    size_t bytes_read() const {return read_bytes;}
+
+    /// Call f(records, count) on the edges [first, last) of the file, in
+    /// order, a block at a time. Returns false on a read error.
+    template<typename F>
+    bool scan(size_t first, size_t last, F f) const {
+        std::vector<edge_record> buffer(std::min(block, last - first));
+        for (size_t e = first; e < last;) {
+            size_t count = std::min(block, last - e);
+            // start reading the next block while this one is processed
+            if (e + count < last)
+                posix_fadvise(fd, offset(e + count),
+                              std::min(block, last - e - count) *
+                                  sizeof(edge_record),
+                              POSIX_FADV_WILLNEED);
+            if (!read(buffer.data(), e, count))
+                return false;
+            f(buffer.data(), count);
+            e += count;
+        }
+        return true;
+    }
+
+    /// Call f(records, count) on every edge of the file.
+    template<typename F>
+    bool scan(F f) const {return scan(0, edges, f);}
+
+    /// The run index: on return the edges of vertex v are those in
+    /// [runs[v], runs[v + 1]). Takes one pass over the file, and fails if
+    /// the edges are not sorted by source.
+    bool index(std::vector<uint64_t>& runs) const {
+        runs.assign(vertices + 1, 0);
+        bool sorted = true;
+        uint32_t last = 0;
+        bool read_all = scan([&](const edge_record* r, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                sorted = sorted && r[i].source >= last &&
+                         r[i].source < vertices && r[i].target < vertices;
+                last = r[i].source;
+                if (sorted)
+                    ++runs[r[i].source + 1];
+            }
+        });
+        for (size_t v = 0; v < vertices; ++v)
+            runs[v + 1] += runs[v];
+        return read_all && sorted;
+    }
+
+  private:
+
+    static off_t offset(size_t e) {
+        return off_t(sizeof(edge_file_header) + e * sizeof(edge_record));
+    }
+
+    bool read(edge_record* to, size_t first, size_t count) const {
+        char* p = reinterpret_cast<char*>(to);
+        size_t len = count * sizeof(edge_record);
+        off_t at = offset(first);
+        while (len > 0) {
+            ssize_t r = pread(fd, p, len, at);
+            if (r <= 0)
+                return false;
+            p += r;
+            at += r;
+            len -= r;
+            read_bytes += r;
+        }
+        return true;
+    }
+
+    int fd;
+    size_t vertices;
+    size_t edges;
+    size_t block;               // edges per read
+    mutable size_t read_bytes;
+};
+
+// BFS from dense vertex source over the edges of f, following their
+// direction. On return depth[v] is the hop distance of v and parent[v] its
+// BFS-tree parent, npos when v is unreached and for the parent of the
+// source. runs is f's run index, from edge_file::index, so that several
+// searches share one pass to build it. Returns false on a read error.
+inline bool external_bfs(const edge_file& f,
+                         const std::vector<uint64_t>& runs, size_t source,
+                         std::vector<size_t>& depth,
+                         std::vector<size_t>& parent) {
+    const size_t n = f.num_vertices();
+    const size_t npos = edge_file::npos;
+    depth.assign(n, npos);
+    parent.assign(n, npos);
+    if (source >= n)
+        return true;
+
+    // runs closer than this are read as one, gap and all
+    const uint64_t gap = (64 << 10) / sizeof(edge_record);
+
+    std::vector<size_t> frontier(1, source), next;
+    depth[source] = 0;
+    for (size_t level = 0; !frontier.empty(); ++level) {
+        // frontier is sorted, so its runs come in file order
+        next.clear();
+        auto visit = [&](const edge_record* r, size_t count) {
+            for (size_t i = 0; i < count; ++i)
+                if (depth[r[i].source] == level &&
+                    depth[r[i].target] == npos) {
+                    depth[r[i].target] = level + 1;
+                    parent[r[i].target] = r[i].source;
+                    next.push_back(r[i].target);
+                }
+        };
+        for (size_t i = 0; i < frontier.size();) {
+            uint64_t first = runs[frontier[i]];
+            uint64_t last = runs[frontier[i] + 1];
+            for (++i; i < frontier.size() && runs[frontier[i]] <= last + gap;
+                 ++i)
+                last = runs[frontier[i] + 1];
+            if (first != last && !f.scan(first, last, visit))
+                return false;
+        }
+        std::sort(next.begin(), next.end());
+        frontier.swap(next);
+    }
+    return true;
+}
+
+// The same, building the run index first.
+inline bool external_bfs(const edge_file& f, size_t source,
+                         std::vector<size_t>& depth,
+                         std::vector<size_t>& parent) {
+    std::vector<uint64_t> runs;
+    return f.index(runs) && external_bfs(f, runs, source, depth, parent);
+}
+
+// Weakly connected components of the edges of f in one pass over the file,
+// with a union-find that always links the larger root under the smaller.
+// On return component[v] is numbered densely from 0 in order of first
+// appearance, as connected_components numbers it, and components holds
+// their number. Returns false on a read error.
+inline bool external_connected_components(const edge_file& f,
+                                          std::vector<size_t>& component,
+                                          size_t& components) {
+    const size_t n = f.num_vertices();
+    std::vector<size_t>& root = component;
+    root.resize(n);
+    for (size_t v = 0; v < n; ++v)
+        root[v] = v;
+
+    auto find = [&root](size_t v) {
+        // path halving
+        while (root[v] != v) {
+            root[v] = root[root[v]];
+            v = root[v];
+        }
+        return v;
+    };
+    bool read_all = f.scan([&](const edge_record* r, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            if (r[i].source >= n || r[i].target >= n)
+                continue;
+            size_t a = find(r[i].source);
+            size_t b = find(r[i].target);
+            if (a < b)
+                root[b] = a;
+            else if (b < a)
+                root[a] = b;
+        }
+    });
+
+    // every parent is smaller than its child, so in vertex order each
+    // vertex's parent already points at its root; then number the roots,
+    // which come first in their component, and overwrite each entry with
+    // the number of its root
+    for (size_t v = 0; v < n; ++v)
+        root[v] = root[root[v]];
+    components = 0;
+    for (size_t v = 0; v < n; ++v)
+        component[v] = root[v] == v ? components++ : component[root[v]];
+    return read_all;
+}
+
+#endif
@@ -6,7 +6,18 @@
 #include <list>
 #include <utility>
 #include <map>
+#include <memory>
 #include <algorithm>
+#include <vector>
+
+// Define GRAPH_MEMORY_ACCOUNTING before including this header for
+// memory_usage(). It routes every allocation through a per-graph account,
+// which makes each map one allocator larger; without it, the maps use
+// std::allocator. The macro changes the layout of graph, so it must be
+// defined the same way in every translation unit of a program.
+#ifdef GRAPH_MEMORY_ACCOUNTING
+#include "memory_usage.h"
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 /// A generic adjacency-list graph where each vertex stores a VertexProperty and
@@ -22,6 +33,16 @@ class graph {
   class edge;
   class vertex_counter;
 
+#ifdef GRAPH_MEMORY_ACCOUNTING
+  // Counts the bytes of every allocation below. On the heap so containers
+  // can keep pointing at it, and declared ahead of them so it outlives them.
+  std::unique_ptr<memory_account> account;
+
+  template<typename T> using allocator = tracking_allocator<T>;
+#else
+  template<typename T> using allocator = std::allocator<T>;
+#endif
+
   public:
 
     // Required public types
@@ -32,23 +53,33 @@ class graph {
     /// Unique edge identifier represents pair of vertex descriptors
     typedef std::pair<size_t, size_t> edge_descriptor;
 
+    /// Property types, exposed so algorithms can size their own storage
+    typedef VertexProperty vertex_property;
+    typedef EdgeProperty edge_property;
+
     ///@todo Choose a container for the vertices. It should contain "vertex*" or
     ///      shared_ptr<vertex>.
     /// example:
     //    typedef std::list<vertex*> MyVertexContainer;
 
     // implemented using a map so the vertexes can be found by their descriptors
-    typedef std::map<vertex_descriptor, vertex*> MyVertexContainer;
+    typedef std::map<vertex_descriptor, vertex*, std::less<vertex_descriptor>,
+                     allocator<std::pair<const vertex_descriptor, vertex*> > >
+        MyVertexContainer;
 
     ///@todo Choose a container for the edges. It should contain "edge*" or
     ///      shared_ptr<edge>.
     /// example:
-    typedef std::map<edge_descriptor, edge*> MyEdgeContainer;
+    typedef std::map<edge_descriptor, edge*, std::less<edge_descriptor>,
+                     allocator<std::pair<const edge_descriptor, edge*> > >
+        MyEdgeContainer;
 
     ///@todo Choose a container for the adjacency lists. It should contain
     ///      "edge*" or shared_ptr<edge>.
     /// example:
-    typedef std::map<edge_descriptor, edge*> MyAdjEdgeContainer;
+    typedef std::map<edge_descriptor, edge*, std::less<edge_descriptor>,
+                     allocator<std::pair<const edge_descriptor, edge*> > >
+        MyAdjEdgeContainer;
 
     // Vertex iterators
     typedef typename MyVertexContainer::iterator vertex_iterator;
@@ -68,11 +99,21 @@ class graph {
     MyEdgeContainer edges;              // container for edges
     vertex_counter counter;
 
-
     // Required graph operations
 
     ///@todo Define constructor/destructor
+#ifdef GRAPH_MEMORY_ACCOUNTING
+    graph() :
+        account(new memory_account),
+        vertices(std::less<vertex_descriptor>(),
+                 typename MyVertexContainer::allocator_type(account.get(),
+                                                            MEMORY_INDEX)),
+        edges(std::less<edge_descriptor>(),
+              typename MyEdgeContainer::allocator_type(account.get(),
+                                                       MEMORY_INDEX)) {}
+#else
     graph() {}
+#endif
 
     ~graph() {
         clear();
@@ -81,6 +122,82 @@ class graph {
     graph(const graph&) = delete;             ///< Copy is disabled.
     graph& operator=(const graph&) = delete;  ///< Copy is disabled.
 
+    // moving hands over the maps and the heap objects they point to, so it
+    // takes constant time; the moved-from graph is left empty
+    graph(graph&& other) : graph() {
+        swap(other);
+    }
+
+    graph& operator=(graph&& other) {
+        if (this != &other) {
+            clear();
+            swap(other);
+        }
+        return *this;
+    }
+
+    // exchange the contents of two graphs in constant time; both epochs
+    // move past both old ones, so neither graph reuses an epoch
+    void swap(graph& other) {
+#ifdef GRAPH_MEMORY_ACCOUNTING
+        std::swap(account, other.account);
+#endif
+        vertices.swap(other.vertices);
+        edges.swap(other.edges);
+        std::swap(counter, other.counter);
+        mutations = other.mutations =
+            std::max(mutations, other.mutations) + 1;
+    }
+
+    // return a deep copy of the graph with the same descriptors
+    graph clone() const {
+        graph c;
+        c.copy_from(*this);
+        c.counter = counter;
+        return c;
+    }
+
+    // replace the contents with a copy of source, a graph or a view of one
+    // (see graph_view.h), keeping its descriptors. Copying a graph onto
+    // itself leaves it as it is; a view of this graph is copied into a
+    // temporary first, which is then swapped in. Vertices and edges come out
+    // of source in key order, so each one belongs at the end of every map it
+    // goes into and is inserted there with a hint instead of a search.
+    template<typename Source>
+    void copy_from(const Source& source) {
+        if (static_cast<const void*>(&source) == this)
+            return;
+        if (static_cast<const void*>(viewed(source, 0)) == this) {
+            graph copy;
+            copy.copy_from(source);
+            swap(copy);
+            return;
+        }
+        clear();
+        std::vector<vertex*> by_desc;
+        for (auto v = source.vertices_cbegin(); v != source.vertices_cend();
+             ++v) {
+            vertex* nv = make_vertex(v->first, v->second->property());
+            vertices.emplace_hint(vertices.end(), v->first, nv);
+            if (v->first >= by_desc.size())
+                by_desc.resize(2 * v->first + 1, nullptr);
+            by_desc[v->first] = nv;
+        }
+        for (auto e = source.edges_cbegin(); e != source.edges_cend(); ++e) {
+            vertex_descriptor s = e->second->source();
+            vertex_descriptor t = e->second->target();
+            edge* ne = make_edge(s, t, e->second->property());
+            edges.emplace_hint(edges.end(), e->first, ne);
+            MyAdjEdgeContainer& out = by_desc[s]->adj_edge;
+            out.emplace_hint(out.end(), e->first, ne);
+            MyAdjEdgeContainer& in = by_desc[t]->adj_edge;
+            in.emplace_hint(in.end(), e->first, ne);
+        }
+        counter = vertex_counter(vertices.empty() ? 0 :
+                                 vertices.rbegin()->first + 1);
+        ++mutations;
+    }
+
     ///@todo Define vertex iterator operations
     vertex_iterator vertices_begin() {return vertices.begin();}
     const_vertex_iterator vertices_cbegin() const {return vertices.cbegin();}
@@ -103,6 +220,25 @@ class graph {
        return edges.size();
     }
 
+#ifdef GRAPH_MEMORY_ACCOUNTING
+    // return the live bytes of the graph by category, and its peak; see
+    // memory_usage.h. Each adj_edge map carries its allocator, so the
+    // adjacency bytes include that many more than std::allocator would take.
+    memory_report memory_usage() const {
+       memory_report r = account->report();
+       r.allocators = vertices.size() *
+           (sizeof(MyAdjEdgeContainer) -
+            sizeof(std::map<edge_descriptor, edge*>));
+       return r;
+    }
+#endif
+
+    // return the mutation epoch: it changes whenever a vertex or edge is
+    // inserted or erased, so results computed at an earlier epoch are stale
+    size_t epoch() const {
+       return mutations;
+    }
+
     // find a vertex in the graph
     vertex_iterator find_vertex(vertex_descriptor vd) {
         // uses the map's member function find() to search for the desired vertex
@@ -132,7 +268,8 @@ class graph {
         // assigns the vertex a value based on the vertex counter
         vertex_descriptor vd = counter.next();
         // inserts a new vertex using the map's []operator
-        vertices[vd] = new vertex(vd, vp);
+        vertices[vd] = make_vertex(vd, vp);
+        ++mutations;
         return vd;
     }
 
@@ -148,12 +285,13 @@ class graph {
         if(va == vertices.end()) {v1 = insert_vertex(v1); va = find_vertex(v1);}
         if(vb == vertices.end()) {v2 = insert_vertex(v2); vb = find_vertex(v2);}
         // create the edge
-        edge* e = new edge(v1,v2,ep);
+        edge* e = make_edge(v1, v2, ep);
         // add it to the master edge map
         edges[ed] = e;
         // add the edge to the vertices' adjacent edge maps
         va->second->adj_edge[ed] = e;
         vb->second->adj_edge[ed] = e;
+        ++mutations;
 
         return ed;
     }
@@ -170,13 +308,14 @@ class graph {
     void erase_vertex(vertex_descriptor v) {
         // find the desired vertex in the vertex map
         vertex_iterator eraser = vertices.find(v);
-        // find its adjacent edge map
-        edge_iterator e = eraser->second->adj_edge.begin();
-        while(e != eraser->second->adj_edge.end()) {
-            // for every edge adjacent to it, delete the edge
-            erase_edge(e->first);
-            ++e;
-        }
+        // for every edge adjacent to it, delete the edge; erase_edge removes
+        // it from the adjacent edge map, so always take the first one left
+        while(!eraser->second->adj_edge.empty())
+            erase_edge(eraser->second->adj_edge.begin()->first);
+        // delete the vertex itself and its entry in the vertex map
+        destroy_vertex(eraser->second);
+        vertices.erase(eraser);
+        ++mutations;
     }
 
     // erase a directed edge
@@ -197,18 +336,16 @@ class graph {
         // find the actual edge
         auto iterator = edges.find(e);
         // delete it
-        delete iterator->second;
+        destroy_edge(iterator->second);
         // delete the final pointer from the master edge map
         edges.erase(e);
+        ++mutations;
     }
 
     // clear all edges and vertices from the graph
     void clear() {
-        vertex_iterator v = vertices.begin();
-        while(v != vertices.end()) {
-           erase_vertex(v->first);
-           ++v;
-        }
+        while(!vertices.empty())
+           erase_vertex(vertices.begin()->first);
     }
 
     // Friend declarations for input/output.
@@ -232,7 +369,17 @@ class graph {
 
       public:
 
-        vertex(vertex_descriptor vd, const VertexProperty& vp) : desc(vd), prop(vp) {}
+#ifdef GRAPH_MEMORY_ACCOUNTING
+        vertex(vertex_descriptor vd, const VertexProperty& vp,
+               memory_account* a) :
+            adj_edge(std::less<edge_descriptor>(),
+                     typename MyAdjEdgeContainer::allocator_type(
+                         a, MEMORY_ADJACENCY)),
+            desc(vd), prop(vp) {}
+#else
+        vertex(vertex_descriptor vd, const VertexProperty& vp) :
+            desc(vd), prop(vp) {}
+#endif
 
         adj_edge_iterator begin() {return adj_edge.begin();}
         const_adj_edge_iterator cbegin() const {return adj_edge.cbegin();}
@@ -312,6 +459,72 @@ class graph {
         size_t label;
     };
 
+    // bumped by every insert and erase, see epoch()
+    size_t mutations = 0;
+
+    // the graph a view looks at, or nothing for any other source of
+    // copy_from
+    template<typename Source>
+    static auto viewed(const Source& source, int)
+        -> decltype(&source.base()) {
+        return &source.base();
+    }
+
+    template<typename Source>
+    static const void* viewed(const Source&, long) {
+        return nullptr;
+    }
+
+#ifdef GRAPH_MEMORY_ACCOUNTING
+    // Vertices and edges are allocated through the account. Apart from the
+    // property, and a vertex's adjacency map, they count as index.
+    vertex* make_vertex(vertex_descriptor vd, const VertexProperty& vp) {
+        void* p = account->allocate(MEMORY_INDEX, sizeof(vertex));
+        account->recount(MEMORY_INDEX, MEMORY_PROPERTIES,
+                         sizeof(VertexProperty));
+        account->recount(MEMORY_INDEX, MEMORY_ADJACENCY,
+                         sizeof(MyAdjEdgeContainer));
+        return new(p) vertex(vd, vp, account.get());
+    }
+
+    void destroy_vertex(vertex* v) {
+        v->~vertex();
+        account->recount(MEMORY_PROPERTIES, MEMORY_INDEX,
+                         sizeof(VertexProperty));
+        account->recount(MEMORY_ADJACENCY, MEMORY_INDEX,
+                         sizeof(MyAdjEdgeContainer));
+        account->deallocate(MEMORY_INDEX, v, sizeof(vertex));
+    }
+
+    edge* make_edge(vertex_descriptor s, vertex_descriptor t,
+                    const EdgeProperty& ep) {
+        void* p = account->allocate(MEMORY_INDEX, sizeof(edge));
+        account->recount(MEMORY_INDEX, MEMORY_PROPERTIES,
+                         sizeof(EdgeProperty));
+        return new(p) edge(s, t, ep);
+    }
+
+    void destroy_edge(edge* e) {
+        e->~edge();
+        account->recount(MEMORY_PROPERTIES, MEMORY_INDEX,
+                         sizeof(EdgeProperty));
+        account->deallocate(MEMORY_INDEX, e, sizeof(edge));
+    }
+#else
+    vertex* make_vertex(vertex_descriptor vd, const VertexProperty& vp) {
+        return new vertex(vd, vp);
+    }
+
+    void destroy_vertex(vertex* v) {delete v;}
+
+    edge* make_edge(vertex_descriptor s, vertex_descriptor t,
+                    const EdgeProperty& ep) {
+        return new edge(s, t, ep);
+    }
+
+    void destroy_edge(edge* e) {delete e;}
+#endif
+
 };
 
 ///@todo Define io operations for the graph.
@@ -6,6 +6,12 @@
 #include <algorithm>
 #include <vector>
 #include <iostream>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "connected_components.h"
+#include "csr_graph.h"
 // This is an example list of the basic algorithms we will work with in class.
 //
 // In general this is what the following template parameters are:
@@ -94,6 +100,129 @@ void BFS(const Graph& g,
     }
 }
 
+// Run one multi-source BFS batch over W 64-bit words of per-vertex state, so
+// a batch covers up to 64 * W sources. Bit i of a vertex's words says whether
+// source i has seen it (seen) or reached it on the current level (visit).
+// d and p point at k rows of n entries each.
+template<size_t W, typename Csr>
+void multi_source_bfs_batch(const Csr& c, const size_t* sources, size_t k,
+                            size_t* d, size_t* p) {
+    const size_t n = c.num_vertices();
+    std::vector<uint64_t> seen(n * W, 0);
+    std::vector<uint64_t> visit(n * W, 0);
+    std::vector<uint64_t> next(n * W, 0);
+
+    for (size_t i = 0; i < k; ++i) {
+        size_t s = sources[i];
+        if (s == Csr::npos)
+            continue;
+        uint64_t bit = uint64_t(1) << (i % 64);
+        seen[s * W + i / 64] |= bit;
+        visit[s * W + i / 64] |= bit;
+        d[i * n + s] = 0;
+    }
+
+    bool active = true;
+    for (size_t level = 1; active; ++level) {
+        active = false;
+
+        for (size_t v = 0; v < n; ++v) {
+            uint64_t* vv = &visit[v * W];
+            uint64_t any = 0;
+            for (size_t w = 0; w < W; ++w)
+                any |= vv[w];
+            if (any == 0)
+                continue;
+
+            // one pass over v's edges advances every source that reached v
+            for (const size_t* u = c.neighbors_begin(v);
+                 u != c.neighbors_end(v); ++u) {
+                uint64_t* su = &seen[*u * W];
+                uint64_t* nu = &next[*u * W];
+                for (size_t w = 0; w < W; ++w) {
+                    uint64_t fresh = vv[w] & ~su[w];
+                    if (fresh == 0)
+                        continue;
+                    su[w] |= fresh;
+                    nu[w] |= fresh;
+                    active = true;
+                    while (fresh != 0) {
+                        size_t i = w * 64 + __builtin_ctzll(fresh);
+                        d[i * n + *u] = level;
+                        p[i * n + *u] = v;
+                        fresh &= fresh - 1;
+                    }
+                }
+            }
+
+            // clearing as we go leaves visit empty for reuse as next
+            for (size_t w = 0; w < W; ++w)
+                vv[w] = 0;
+        }
+
+        visit.swap(next);
+    }
+}
+
+// Multi-source BFS over a CSR snapshot. Traverses the graph once per batch of
+// up to 256 sources instead of once per source (MS-BFS). sources holds dense
+// indices; on return d and p hold one row of n entries per source, row-major,
+// with the hop distance and BFS-tree parent of each vertex (npos when the
+// vertex is unreached, and for the parent of the source itself).
+template<typename Csr>
+void multi_source_bfs_dense(const Csr& c, const std::vector<size_t>& sources,
+                            std::vector<size_t>& d, std::vector<size_t>& p) {
+    const size_t n = c.num_vertices();
+    d.assign(sources.size() * n, Csr::npos);
+    p.assign(sources.size() * n, Csr::npos);
+
+    for (size_t first = 0; first < sources.size(); first += 256) {
+        size_t k = std::min<size_t>(256, sources.size() - first);
+        size_t* bd = d.data() + first * n;
+        size_t* bp = p.data() + first * n;
+
+        // use the narrowest word count that holds the batch
+        if (k <= 64)
+            multi_source_bfs_batch<1>(c, &sources[first], k, bd, bp);
+        else if (k <= 128)
+            multi_source_bfs_batch<2>(c, &sources[first], k, bd, bp);
+        else
+            multi_source_bfs_batch<4>(c, &sources[first], k, bd, bp);
+    }
+}
+
+// Multi-source BFS from every vertex in sources. Fills p[i] and d[i] with the
+// BFS-tree parents and hop distances of the vertices reachable from
+// sources[i]; like BFS, the source itself gets a distance but no parent.
+template<typename Graph, typename ParentMap, typename DistanceMap>
+void multi_source_bfs(const Graph& g,
+    const std::vector<typename Graph::vertex_descriptor>& sources,
+    std::vector<ParentMap>& p, std::vector<DistanceMap>& d) {
+
+    csr_graph<Graph> c(g);
+    const size_t n = c.num_vertices();
+
+    std::vector<size_t> s;
+    s.reserve(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i)
+        s.push_back(c.index(sources[i]));
+
+    std::vector<size_t> dist, parent;
+    multi_source_bfs_dense(c, s, dist, parent);
+
+    p.assign(sources.size(), ParentMap());
+    d.assign(sources.size(), DistanceMap());
+    for (size_t i = 0; i < sources.size(); ++i) {
+        for (size_t v = 0; v < n; ++v) {
+            if (dist[i * n + v] == c.npos)
+                continue;
+            d[i][c.descriptor(v)] = dist[i * n + v];
+            if (parent[i * n + v] != c.npos)
+                p[i][c.descriptor(v)] = c.descriptor(parent[i * n + v]);
+        }
+    }
+}
+
 ///@bonus Implement depth-first search.
 template<typename Graph, typename ParentMap>
 void depth_first_search(const Graph& g,
@@ -108,91 +237,108 @@ template<typename Graph, typename ParentMap>
 void mst_kruskals(const Graph& g, ParentMap& p) {
     // Initialization and setup //
     //////////////////////////////
-    std::multimap<size_t,typename Graph::edge_descriptor> m;
+    typedef typename Graph::edge_descriptor edge_descriptor;
+    std::multimap<typename Graph::edge_property, edge_descriptor> m;
 
-    for (auto i = g.edges.begin(); i != g.edges.end(); ++i) {
+    for (auto i = g.edges_cbegin(); i != g.edges_cend(); ++i) {
         // insert the edges into a map that sorts them in ascending order
-        m.insert(std::pair<size_t,
-                 typename Graph::edge_descriptor>(i->second->property(),
-                 i->first));
+        m.insert(std::make_pair(i->second->property(), i->first));
     }
 
-    auto e = m.end();
-    --e;
-
-    // if the first edge weight equals the last edge weight, then
-    // all the edges have the same weight
-    if (m.begin()->first == e->first) {
+    if (m.empty()) {
         return;
     }
 
-    // defines a cluster as a vector of vertex descriptors
-    typedef std::vector<typename Graph::vertex_descriptor> cluster;
-
-    // creates a cluster of clusters, (i.e., each vertex has its own vector,
-    // so more can be added during the merge process)
-    std::vector<cluster> clusters(g.num_vertices());
+    // number the vertices densely, so deleted vertices leave no holes
+    csr_graph<Graph> c(g);
+    const size_t n = c.num_vertices();
 
-    // creates a vector of pointers to each of the clusters
-    std::vector<cluster*> cluster_map(g.num_vertices());
+    // a spanning forest has one edge fewer than vertices in each component;
+    // once that many edges are in, the rest of the queue can be skipped
+    std::vector<size_t> component;
+    size_t forest_edges = n - connected_components(c, component);
 
-    // assumes vertices are from [0,n-1]; if some have been deleted,
-    // this will not work
+    // defines a cluster as a vector of dense vertex indices
+    typedef std::vector<size_t> cluster;
 
-    // for every vertex in g
-    for (size_t i = 0; i < g.num_vertices(); ++i ) {
-        // add the vertex to its own cluster
+    // each vertex starts in its own cluster, and cluster_map points every
+    // vertex at the cluster it is currently in
+    std::vector<cluster> clusters(n);
+    std::vector<cluster*> cluster_map(n);
+    for (size_t i = 0; i < n; ++i) {
         clusters[i].push_back(i);
-        // set a pointer to that cluster
         cluster_map[i] = &clusters[i];
     }
 
     // Creating the MST using Kruskal's Algorithm //
     ////////////////////////////////////////////////
 
-    while (p.size() < g.num_vertices() - 1) {
+    size_t added = 0;
+    for (auto s = m.begin(); s != m.end() && added < forest_edges; ++s) {
+        // gets the edge to be checked
+        edge_descriptor ed = s->second;
+        cluster* a = cluster_map[c.index(ed.first)];
+        cluster* b = cluster_map[c.index(ed.second)];
 
-        auto s = m.begin();
-        auto a = m.begin()->first;
+        // skip edges inside one cluster
+        if (a == b) {
+            continue;
+        }
 
-        // gets the edge to be checked
-        std::pair<size_t,size_t> n = s->second;
-        m.erase(a);
-
-        // checks if the vertices are in different clusters
-        if (cluster_map[n.first] != cluster_map[n.second]) {
-            // inserts the edge into the parent map
-            p.insert(std::pair<size_t,size_t>(n.second, n.first));
-
-            // if the first cluster is larger than the second cluster
-            if ((*cluster_map[n.first]).size() > (*cluster_map[n.second]).size()) {
-                auto cl = cluster_map[n.second];
-                for (size_t i = 0; i < cl->size(); ++i) {
-                    // takes an element from the smaller cluster,
-                    // adds it to the larger one (needs cleaning up, probably)
-                    (*cluster_map[n.first]).push_back((*cluster_map[n.second])[i]);
-                    cluster_map[n.second] = cluster_map[n.first];
-                }
-            }
+        // inserts the edge into the parent map
+        p.insert(std::make_pair(ed.second, ed.first));
+        ++added;
 
-            // otherwise, use the other cluster
-            else {
-                auto cl = cluster_map[n.first];
-                for (size_t i = 0; i < cl->size(); ++i) {
-                    // takes an element from the smaller cluster,
-                    // adds it to the larger one (needs cleaning up, probably)
-                    (*cluster_map[n.second]).push_back((*cluster_map[n.first])[i]);
-                    cluster_map[n.first] = cluster_map[n.second];
-                }
-            }
+        // moves every element of the smaller cluster into the larger one
+        if (a->size() < b->size()) {
+            std::swap(a, b);
+        }
+        for (size_t i = 0; i < b->size(); ++i) {
+            a->push_back((*b)[i]);
+            cluster_map[(*b)[i]] = a;
         }
+        cluster().swap(*b);
     }
-
 }
 
 template<typename Graph, typename ParentMap, typename DistanceMap>
 void sssp_dijkstras(const Graph& g, const typename Graph::vertex_descriptor vd,
-    ParentMap& p, DistanceMap& d);
+    ParentMap& p, DistanceMap& d) {
+
+    typedef typename Graph::vertex_descriptor vertex_descriptor;
+    typedef typename Graph::edge_property weight;
+    typedef std::pair<weight, vertex_descriptor> entry;
+
+    // a min-heap of (distance, vertex); stale entries are skipped when popped
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry> > q;
+    d[vd] = weight(0);
+    q.push(entry(weight(0), vd));
+
+    while (!q.empty()) {
+        entry top = q.top();
+        q.pop();
+        if (d[top.second] < top.first)
+            continue;
+
+        auto i_curr = g.find_vertex(top.second);
+
+        // relax each out-edge of the node
+        for (auto i_e = (*i_curr).second->begin();
+             i_e != (*i_curr).second->end(); ++i_e) {
+            if ((*i_e).second->source() != top.second)
+                continue;
+
+            auto n = (*i_e).second->target();
+            weight nd = top.first + (*i_e).second->property();
+            auto i_d = d.find(n);
+            if (i_d == d.end() || nd < i_d->second) {
+                d[n] = nd;
+                p[n] = top.second;
+                q.push(entry(nd, n));
+            }
+        }
+    }
+}
 
 template<typename Graph, typename ParentMap, typename DistanceMap>
 void sssp_bellman_ford(const Graph& g,
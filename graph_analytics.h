@@ -0,0 +1,325 @@
+#ifndef _GRAPH_ANALYTICS_H_
+#define _GRAPH_ANALYTICS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "csr_graph.h"
+#include "scheduler.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// Pull-based engine for iterative vertex-centric analytics.
+///
+/// Each pass computes, for every vertex v, the sum of x[u] over its in-edges
+/// u -> v: a sparse matrix-vector product with the transposed adjacency
+/// matrix. Pulling means every vertex writes only its own sum, so threads
+/// need no atomics. Destinations are split into stripes of about the same
+/// number of in-edges, four per thread, which the scheduler shares out so
+/// that threads that finish early take over the remaining stripes. Within a
+/// stripe, in-edges are grouped into tiles by source block, and a block's
+/// slice of x fits in block_bytes of cache. A stripe walks its tiles block
+/// by block, so the random reads of x stay inside one cache-sized window at
+/// a time. Per-vertex arrays are plain contiguous Real arrays, float or
+/// double; float halves the memory traffic of every pass.
+///
+/// The engine is a snapshot, like the csr_graph it is built from.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Real>
+class pull_engine {
+
+  public:
+
+    template<typename Graph>
+    explicit pull_engine(const csr_graph<Graph>& c, size_t threads = 0,
+                         size_t block_bytes = 256 * 1024) :
+        n(c.num_vertices()), thread_cap(threads), out_deg(c.num_vertices()) {
+        if (threads == 0)
+            threads = scheduler::global().num_threads();
+        stripes = std::max<size_t>(1, std::min(4 * threads, n));
+        block_size = std::max<size_t>(1, block_bytes / sizeof(Real));
+        blocks = n == 0 ? 1 : (n + block_size - 1) / block_size;
+
+        for (size_t v = 0; v < n; ++v)
+            out_deg[v] = c.degree(v);
+        csr_graph<Graph> t = c.transpose();
+
+        // cut the destinations into stripes of about m / stripes in-edges
+        bounds.assign(1, 0);
+        size_t edges = 0;
+        for (size_t v = 0; v < n; ++v) {
+            edges += t.degree(v);
+            if (edges * stripes >= t.num_edges() * bounds.size() &&
+                bounds.size() < stripes)
+                bounds.push_back(v + 1);
+        }
+        while (bounds.size() <= stripes)
+            bounds.push_back(n);
+
+        // in-lists are sorted by source, so each block's sources in one
+        // list form a single run
+        tiles.resize(stripes * blocks);
+        for (size_t s = 0; s < stripes; ++s) {
+            for (size_t b = 0; b < blocks; ++b)
+                tiles[s * blocks + b].offsets.assign(1, 0);
+            for (size_t v = bounds[s]; v < bounds[s + 1]; ++v) {
+                const size_t* u = t.neighbors_begin(v);
+                const size_t* end = t.neighbors_end(v);
+                while (u != end) {
+                    size_t b = *u / block_size;
+                    tile& tl = tiles[s * blocks + b];
+                    for (; u != end && *u / block_size == b; ++u)
+                        tl.sources.push_back(uint32_t(*u));
+                    tl.targets.push_back(uint32_t(v));
+                    tl.offsets.push_back(tl.sources.size());
+                }
+            }
+        }
+    }
+
+    size_t num_vertices() const {return n;}
+
+    /// Number of out-edges of dense vertex v.
+    size_t out_degree(size_t v) const {return out_deg[v];}
+
+    /// One pull pass: y[v] = sum of x[u] over the in-edges u -> v.
+    void pull(const std::vector<Real>& x, std::vector<Real>& y) const {
+        y.resize(n);
+        const Real* xs = x.data();
+        Real* ys = y.data();
+        parallel_for(0, stripes, 1, [this, xs, ys](size_t first,
+                                                   size_t last) {
+            for (size_t s = first; s < last; ++s) {
+                std::fill(ys + bounds[s], ys + bounds[s + 1], Real(0));
+                for (size_t b = 0; b < blocks; ++b) {
+                    const tile& tl = tiles[s * blocks + b];
+                    for (size_t i = 0; i < tl.targets.size(); ++i) {
+                        Real sum = 0;
+                        for (size_t e = tl.offsets[i]; e < tl.offsets[i + 1];
+                             ++e)
+                            sum += xs[tl.sources[e]];
+                        ys[tl.targets[i]] += sum;
+                    }
+                }
+            }
+        }, thread_cap);
+    }
+
+    /// Call f(v) for every vertex in parallel and return the sum of the
+    /// results, for convergence checks.
+    template<typename F>
+    double map_reduce(F f) const {
+        return parallel_reduce(0, n, 4096, 0.0, [&f](size_t begin,
+                                                     size_t end) {
+            double sum = 0;
+            for (size_t v = begin; v < end; ++v)
+                sum += f(v);
+            return sum;
+        }, [](double a, double b) {return a + b;}, thread_cap);
+    }
+
+  private:
+
+    // The in-edges of one stripe whose sources fall in one block: the
+    // sources of targets[i] are sources[offsets[i], offsets[i + 1]).
+    struct tile {
+        std::vector<uint32_t> targets;
+        std::vector<size_t> offsets;
+        std::vector<uint32_t> sources;
+    };
+
+    size_t n;
+    size_t thread_cap;              // threads per pass, 0 for all
+    size_t stripes;
+    size_t block_size;              // sources per block
+    size_t blocks;
+    std::vector<size_t> out_deg;
+    std::vector<size_t> bounds;     // stripes + 1 stripe boundaries
+    std::vector<tile> tiles;        // stripe-major, stripes * blocks
+};
+
+// Power iteration shared by PageRank and personalized PageRank. A surfer
+// follows a random out-edge with probability damping and otherwise jumps to
+// vertex v with probability teleport[v]; from a vertex without out-edges it
+// always jumps. Stops once the L1 change of the ranks drops below tolerance.
+// Returns the number of iterations run.
+template<typename Real>
+size_t pagerank_iterate(const pull_engine<Real>& e,
+                        const std::vector<Real>& teleport,
+                        std::vector<Real>& rank, double damping,
+                        double tolerance, size_t max_iterations) {
+    const size_t n = e.num_vertices();
+    std::vector<Real> contrib(n), sums(n), next(n);
+    rank = teleport;
+
+    size_t iterations = 0;
+    while (iterations < max_iterations) {
+        ++iterations;
+        // each vertex passes its rank evenly along its out-edges; the rank
+        // of dead ends is spread by teleport instead
+        double dangling = e.map_reduce([&](size_t v) -> double {
+            size_t d = e.out_degree(v);
+            contrib[v] = d == 0 ? Real(0) : rank[v] / Real(d);
+            return d == 0 ? double(rank[v]) : 0.0;
+        });
+        e.pull(contrib, sums);
+
+        Real follow = Real(damping);
+        Real jump = Real(1 - damping + damping * dangling);
+        double change = e.map_reduce([&](size_t v) -> double {
+            next[v] = jump * teleport[v] + follow * sums[v];
+            return std::fabs(double(next[v]) - double(rank[v]));
+        });
+        rank.swap(next);
+        if (change < tolerance)
+            break;
+    }
+    return iterations;
+}
+
+// PageRank of every dense vertex; the ranks sum to 1. Returns the number of
+// iterations run.
+template<typename Real>
+size_t pagerank(const pull_engine<Real>& e, std::vector<Real>& rank,
+                double damping = 0.85, double tolerance = 1e-6,
+                size_t max_iterations = 100) {
+    const size_t n = e.num_vertices();
+    if (n == 0) {
+        rank.clear();
+        return 0;
+    }
+    std::vector<Real> teleport(n, Real(1) / Real(n));
+    return pagerank_iterate(e, teleport, rank, damping, tolerance,
+                            max_iterations);
+}
+
+// Personalized PageRank: as pagerank, but every jump lands on one of the
+// dense vertices in sources, chosen uniformly. Returns the number of
+// iterations run, or 0 with all-zero ranks when sources is empty.
+template<typename Real>
+size_t personalized_pagerank(const pull_engine<Real>& e,
+                             const std::vector<size_t>& sources,
+                             std::vector<Real>& rank,
+                             double damping = 0.85,
+                             double tolerance = 1e-6,
+                             size_t max_iterations = 100) {
+    const size_t n = e.num_vertices();
+    std::vector<Real> teleport(n, Real(0));
+    size_t valid = 0;
+    for (size_t i = 0; i < sources.size(); ++i)
+        if (sources[i] < n)
+            ++valid;
+    if (valid == 0) {
+        rank.assign(n, Real(0));
+        return 0;
+    }
+    for (size_t i = 0; i < sources.size(); ++i)
+        if (sources[i] < n)
+            teleport[sources[i]] += Real(1) / Real(valid);
+    return pagerank_iterate(e, teleport, rank, damping, tolerance,
+                            max_iterations);
+}
+
+// The same over a CSR snapshot. Repeated runs on one graph should keep a
+// pull_engine instead, which lays out the tiles once.
+template<typename Real, typename Graph>
+size_t pagerank(const csr_graph<Graph>& c, std::vector<Real>& rank,
+                double damping = 0.85, double tolerance = 1e-6,
+                size_t max_iterations = 100, size_t threads = 0) {
+    pull_engine<Real> e(c, threads);
+    return pagerank(e, rank, damping, tolerance, max_iterations);
+}
+
+template<typename Real, typename Graph>
+size_t personalized_pagerank(const csr_graph<Graph>& c,
+                             const std::vector<size_t>& sources,
+                             std::vector<Real>& rank,
+                             double damping = 0.85,
+                             double tolerance = 1e-6,
+                             size_t max_iterations = 100,
+                             size_t threads = 0) {
+    pull_engine<Real> e(c, threads);
+    return personalized_pagerank(e, sources, rank, damping, tolerance,
+                                 max_iterations);
+}
+
+// Whether vertex v takes part in the given round of label_propagation.
+inline bool label_propagation_moves(size_t v, size_t round) {
+    uint64_t h = (uint64_t(v) << 20 ^ round) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    return (h >> 63) != 0;
+}
+
+// Label propagation communities. Every vertex starts with its own dense
+// index as label. Each round, every vertex pulls the labels of its
+// neighbors, ignoring edge direction, and adopts the most frequent one,
+// counting its own label as one vote. Ties keep the current label when it
+// is among the most frequent, and otherwise go to the smallest label.
+//
+// Each round reads only the labels of the round before, so the result does
+// not depend on the thread count. If every vertex moved at once, two sides
+// of a bipartite graph such as a mesh would swap labels forever. So each
+// round only a pseudo-random half of the vertices, fixed by a hash of vertex
+// and round, adopts its choice. Stops when no vertex would change its label
+// or after max_iterations rounds, and returns the number of rounds run.
+template<typename Graph>
+size_t label_propagation(const csr_graph<Graph>& c,
+                         std::vector<size_t>& label,
+                         size_t max_iterations = 100, size_t threads = 0) {
+    const size_t n = c.num_vertices();
+    csr_graph<Graph> t = c.transpose();
+
+    label.resize(n);
+    for (size_t v = 0; v < n; ++v)
+        label[v] = v;
+    std::vector<size_t> next(n);
+
+    size_t rounds = 0;
+    std::atomic<bool> changed(n != 0);
+    while (changed && rounds < max_iterations) {
+        ++rounds;
+        changed = false;
+        parallel_for(0, n, 256, [&](size_t begin, size_t end) {
+            std::vector<size_t> votes;
+            bool any = false;
+            for (size_t v = begin; v < end; ++v) {
+                votes.assign(1, label[v]);
+                for (const size_t* u = c.neighbors_begin(v);
+                     u != c.neighbors_end(v); ++u)
+                    votes.push_back(label[*u]);
+                for (const size_t* u = t.neighbors_begin(v);
+                     u != t.neighbors_end(v); ++u)
+                    votes.push_back(label[*u]);
+                std::sort(votes.begin(), votes.end());
+
+                size_t best = label[v], best_count = 0, own_count = 0;
+                for (size_t i = 0; i < votes.size();) {
+                    size_t j = i;
+                    while (j < votes.size() && votes[j] == votes[i])
+                        ++j;
+                    if (votes[i] == label[v])
+                        own_count = j - i;
+                    if (j - i > best_count) {
+                        best = votes[i];
+                        best_count = j - i;
+                    }
+                    i = j;
+                }
+                size_t choice = own_count == best_count ? label[v] : best;
+                any = any || choice != label[v];
+                next[v] = label_propagation_moves(v, rounds) ? choice :
+                                                               label[v];
+            }
+            if (any)
+                changed = true;
+        }, threads);
+        label.swap(next);
+    }
+    return rounds;
+}
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef _GRAPH_PARTITION_H_
+#define _GRAPH_PARTITION_H_
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "csr_graph.h"
+#include "graph_reorder.h"
+
+// Graph partitioning and shard files.
+//
+// partition_graph() splits a graph into k balanced parts with few cut edges,
+// and write_shards() stores each part as a self-contained shard file that a
+// separate process can load (see sharded_sssp.h).
+
+// Split g into k parts of at most (1 + imbalance) * n / k vertices each,
+// fills part[vd] with the part of every vertex and returns the number of
+// directed edges that cross parts.
+//
+// The starting assignment cuts the BFS order into k contiguous blocks, which
+// already keeps neighborhoods together. Size-constrained label propagation
+// then repeatedly moves each vertex to the part holding most of its
+// neighbors, until a sweep moves nothing or max_sweeps is reached.
+template<typename Graph, typename PartitionMap>
+size_t partition_graph(const Graph& g, size_t k, PartitionMap& part,
+                       double imbalance = 0.05, size_t max_sweeps = 20) {
+    csr_graph<Graph> c(g);
+    const size_t n = c.num_vertices();
+    if (n == 0 || k == 0)
+        return 0;
+
+    std::vector<std::vector<size_t> > adj;
+    undirected_adjacency(c, adj);
+
+    std::vector<size_t> owner(n);
+    std::vector<size_t> size(k, 0);
+    std::vector<typename Graph::vertex_descriptor> order =
+        compute_vertex_order(g, BFS_ORDER);
+    for (size_t i = 0; i < n; ++i) {
+        owner[c.index(order[i])] = i * k / n;
+        ++size[i * k / n];
+    }
+
+    const size_t capacity = size_t((1.0 + imbalance) * n / k) + 1;
+    std::vector<size_t> count(k, 0);
+    std::vector<size_t> touched;
+
+    for (size_t sweep = 0; sweep < max_sweeps; ++sweep) {
+        size_t moved = 0;
+
+        for (size_t v = 0; v < n; ++v) {
+            touched.clear();
+            for (size_t i = 0; i < adj[v].size(); ++i) {
+                size_t q = owner[adj[v][i]];
+                if (count[q]++ == 0)
+                    touched.push_back(q);
+            }
+
+            // only a strict gain moves a vertex, so sweeps settle
+            size_t best = owner[v];
+            for (size_t i = 0; i < touched.size(); ++i) {
+                size_t q = touched[i];
+                if (count[q] > count[best] && size[q] < capacity)
+                    best = q;
+            }
+            for (size_t i = 0; i < touched.size(); ++i)
+                count[touched[i]] = 0;
+
+            if (best != owner[v]) {
+                --size[owner[v]];
+                ++size[best];
+                owner[v] = best;
+                ++moved;
+            }
+        }
+
+        if (moved == 0)
+            break;
+    }
+
+    size_t cut = 0;
+    for (size_t v = 0; v < n; ++v) {
+        part[c.descriptor(v)] = owner[v];
+        for (const size_t* u = c.neighbors_begin(v);
+             u != c.neighbors_end(v); ++u)
+            if (owner[*u] != owner[v])
+                ++cut;
+    }
+    return cut;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// One part of a partitioned graph: the vertices it owns, their out-edges, and
+/// the ghost vertices those edges lead to in other shards, tagged with the
+/// shard that owns them. Descriptors are those of the original graph.
+////////////////////////////////////////////////////////////////////////////////
+template<typename VertexProperty, typename EdgeProperty>
+struct graph_shard {
+
+    struct owned_vertex {
+        size_t descriptor;
+        VertexProperty property;
+    };
+
+    struct ghost_vertex {
+        size_t descriptor;
+        size_t owner;
+    };
+
+    struct shard_edge {
+        size_t source;
+        size_t target;
+        EdgeProperty property;
+    };
+
+    size_t id = 0;
+    size_t num_shards = 0;
+    std::vector<owned_vertex> vertices;
+    std::vector<ghost_vertex> ghosts;
+    std::vector<shard_edge> edges;
+};
+
+// File name of shard s under prefix.
+inline std::string shard_file_name(const std::string& prefix, size_t s) {
+    return prefix + ".shard" + std::to_string(s);
+}
+
+// Shard file format, in the spirit of the .g files:
+//
+//   shard_id num_shards
+//   num_vertices num_ghosts num_edges
+//   descriptor property          (one line per owned vertex)
+//   descriptor owner_shard       (one line per ghost vertex)
+//   source target property       (one line per edge)
+template<typename V, typename E>
+std::istream& operator>>(std::istream& is, graph_shard<V, E>& s) {
+    size_t nv = 0, ng = 0, ne = 0;
+    is >> s.id >> s.num_shards >> nv >> ng >> ne;
+
+    s.vertices.resize(nv);
+    for (size_t i = 0; i < nv; ++i)
+        is >> s.vertices[i].descriptor >> s.vertices[i].property;
+
+    s.ghosts.resize(ng);
+    for (size_t i = 0; i < ng; ++i)
+        is >> s.ghosts[i].descriptor >> s.ghosts[i].owner;
+
+    s.edges.resize(ne);
+    for (size_t i = 0; i < ne; ++i)
+        is >> s.edges[i].source >> s.edges[i].target >> s.edges[i].property;
+
+    return is;
+}
+
+template<typename V, typename E>
+std::ostream& operator<<(std::ostream& os, const graph_shard<V, E>& s) {
+    os << s.id << ' ' << s.num_shards << std::endl;
+    os << s.vertices.size() << ' ' << s.ghosts.size() << ' '
+       << s.edges.size() << std::endl;
+
+    for (size_t i = 0; i < s.vertices.size(); ++i)
+        os << s.vertices[i].descriptor << ' ' << s.vertices[i].property
+           << std::endl;
+
+    for (size_t i = 0; i < s.ghosts.size(); ++i)
+        os << s.ghosts[i].descriptor << ' ' << s.ghosts[i].owner << std::endl;
+
+    // full precision so weights survive the round trip
+    std::streamsize precision = os.precision(17);
+    for (size_t i = 0; i < s.edges.size(); ++i)
+        os << s.edges[i].source << ' ' << s.edges[i].target << ' '
+           << s.edges[i].property << std::endl;
+    os.precision(precision);
+
+    return os;
+}
+
+// Write the k shards of g described by part to shard_file_name(prefix, s).
+// Returns false if a file could not be written.
+template<typename Graph, typename PartitionMap>
+bool write_shards(const Graph& g, const PartitionMap& part, size_t k,
+                  const std::string& prefix) {
+    typedef graph_shard<typename Graph::vertex_property,
+                        typename Graph::edge_property> shard;
+
+    std::vector<shard> shards(k);
+    std::vector<std::vector<bool> > is_ghost(k,
+        std::vector<bool>(g.num_vertices() == 0 ? 0 :
+                          (--g.vertices_cend())->first + 1, false));
+
+    for (size_t s = 0; s < k; ++s) {
+        shards[s].id = s;
+        shards[s].num_shards = k;
+    }
+
+    for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v) {
+        size_t s = part.find(v->first)->second;
+        typename shard::owned_vertex ov = {v->first, v->second->property()};
+        shards[s].vertices.push_back(ov);
+
+        for (auto e = v->second->cbegin(); e != v->second->cend(); ++e) {
+            if (e->second->source() != v->first)
+                continue;
+            size_t t = e->second->target();
+            typename shard::shard_edge se = {v->first, t, e->second->property()};
+            shards[s].edges.push_back(se);
+
+            size_t owner = part.find(t)->second;
+            if (owner != s && !is_ghost[s][t]) {
+                is_ghost[s][t] = true;
+                typename shard::ghost_vertex gv = {t, owner};
+                shards[s].ghosts.push_back(gv);
+            }
+        }
+    }
+
+    for (size_t s = 0; s < k; ++s) {
+        std::ofstream os(shard_file_name(prefix, s).c_str());
+        os << shards[s];
+        if (!os)
+            return false;
+    }
+    return true;
+}
+
+#endif
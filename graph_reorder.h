@@ -0,0 +1,164 @@
+#ifndef _GRAPH_REORDER_H_
+#define _GRAPH_REORDER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "csr_graph.h"
+
+// Vertex relabeling for locality.
+//
+// Descriptors are handed out in insertion order, so on large graphs the
+// neighbors of a vertex usually sit far apart in memory. These functions
+// compute a better order and rebuild the graph with renumbered descriptors,
+// inserting vertices and edges in that order so they are also laid out
+// together on the heap.
+//
+// An order is a vector of the old descriptors listed in their new order, so
+// order[i] is the old descriptor of the i-th new vertex. relabel_graph()
+// reports the descriptor each old vertex got, and translate_parent_map() uses
+// that mapping to turn results computed on the relabeled graph back into the
+// original descriptors.
+
+enum VertexOrder {DEGREE_ORDER, BFS_ORDER, RCM_ORDER};
+
+// Undirected adjacency of g in dense indices: out- and in-neighbors merged,
+// sorted and without duplicates or self-loops.
+template<typename Graph>
+void undirected_adjacency(const csr_graph<Graph>& c,
+                          std::vector<std::vector<size_t> >& adj) {
+    csr_graph<Graph> t = c.transpose();
+    adj.assign(c.num_vertices(), std::vector<size_t>());
+
+    for (size_t v = 0; v < c.num_vertices(); ++v) {
+        std::vector<size_t>& a = adj[v];
+        a.reserve(c.degree(v) + t.degree(v));
+        a.insert(a.end(), c.neighbors_begin(v), c.neighbors_end(v));
+        a.insert(a.end(), t.neighbors_begin(v), t.neighbors_end(v));
+        std::sort(a.begin(), a.end());
+        a.erase(std::unique(a.begin(), a.end()), a.end());
+        a.erase(std::remove(a.begin(), a.end(), v), a.end());
+    }
+}
+
+// Compute a new vertex order for g.
+//
+//  - DEGREE_ORDER: highest degree first, so hubs share cache lines.
+//  - BFS_ORDER: breadth-first from the lowest descriptor of each component,
+//    so each BFS level is stored contiguously.
+//  - RCM_ORDER: reverse Cuthill-McKee. Breadth-first from a minimum degree
+//    vertex of each component, visiting neighbors by increasing degree, then
+//    reversed. This keeps the bandwidth of the adjacency matrix small.
+//
+// Degrees and traversals ignore edge direction.
+template<typename Graph>
+std::vector<typename Graph::vertex_descriptor>
+compute_vertex_order(const Graph& g, VertexOrder kind) {
+    csr_graph<Graph> c(g);
+    const size_t n = c.num_vertices();
+
+    std::vector<std::vector<size_t> > adj;
+    undirected_adjacency(c, adj);
+
+    std::vector<size_t> dense;
+    dense.reserve(n);
+
+    if (kind == DEGREE_ORDER) {
+        for (size_t v = 0; v < n; ++v)
+            dense.push_back(v);
+        std::stable_sort(dense.begin(), dense.end(),
+            [&adj](size_t a, size_t b) {return adj[a].size() > adj[b].size();});
+
+    } else {
+        // candidate roots: in descriptor order for BFS, by degree for RCM
+        std::vector<size_t> roots;
+        for (size_t v = 0; v < n; ++v)
+            roots.push_back(v);
+        if (kind == RCM_ORDER)
+            std::stable_sort(roots.begin(), roots.end(),
+                [&adj](size_t a, size_t b) {return adj[a].size() < adj[b].size();});
+
+        std::vector<bool> placed(n, false);
+        std::vector<size_t> fresh;
+
+        for (size_t r = 0; r < n; ++r) {
+            if (placed[roots[r]])
+                continue;
+
+            // dense doubles as the BFS queue, from this root onward
+            size_t head = dense.size();
+            placed[roots[r]] = true;
+            dense.push_back(roots[r]);
+
+            while (head < dense.size()) {
+                size_t v = dense[head++];
+                fresh.clear();
+                for (size_t i = 0; i < adj[v].size(); ++i) {
+                    if (!placed[adj[v][i]]) {
+                        placed[adj[v][i]] = true;
+                        fresh.push_back(adj[v][i]);
+                    }
+                }
+                if (kind == RCM_ORDER)
+                    std::stable_sort(fresh.begin(), fresh.end(),
+                        [&adj](size_t a, size_t b) {
+                            return adj[a].size() < adj[b].size();
+                        });
+                dense.insert(dense.end(), fresh.begin(), fresh.end());
+            }
+        }
+
+        if (kind == RCM_ORDER)
+            std::reverse(dense.begin(), dense.end());
+    }
+
+    std::vector<typename Graph::vertex_descriptor> order;
+    order.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        order.push_back(c.descriptor(dense[i]));
+    return order;
+}
+
+// Rebuild g into out with its vertices inserted in order. On return
+// old_to_new maps each old descriptor to its new one; out may have handed
+// out descriptors before, so they need not start at 0. Returns false, and
+// leaves out alone, when out is not empty.
+template<typename Graph, typename DescriptorMap>
+bool relabel_graph(const Graph& g,
+                   const std::vector<typename Graph::vertex_descriptor>& order,
+                   Graph& out, DescriptorMap& old_to_new) {
+    if (out.num_vertices() != 0)
+        return false;
+    for (size_t i = 0; i < order.size(); ++i)
+        old_to_new[order[i]] = out.insert_vertex(
+            g.find_vertex(order[i])->second->property());
+
+    // insert each vertex's out-edges together, in the new vertex order
+    for (size_t i = 0; i < order.size(); ++i) {
+        auto v = g.find_vertex(order[i]);
+        for (auto e = v->second->cbegin(); e != v->second->cend(); ++e) {
+            if (e->second->source() != order[i])
+                continue;
+            out.insert_edge(old_to_new[order[i]],
+                            old_to_new[e->second->target()],
+                            e->second->property());
+        }
+    }
+    return true;
+}
+
+// Translate a parent map computed on a relabeled graph back into the original
+// descriptors, given the old_to_new mapping relabel_graph reported.
+template<typename DescriptorMap, typename ParentMap>
+void translate_parent_map(const DescriptorMap& old_to_new,
+                          const ParentMap& relabeled, ParentMap& original) {
+    std::unordered_map<size_t, size_t> new_to_old;
+    for (auto i = old_to_new.begin(); i != old_to_new.end(); ++i)
+        new_to_old[i->second] = i->first;
+    for (auto i = relabeled.begin(); i != relabeled.end(); ++i)
+        original[new_to_old[i->first]] = new_to_old[i->second];
+}
+
+#endif
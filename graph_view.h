@@ -0,0 +1,312 @@
+#ifndef _GRAPH_VIEW_H_
+#define _GRAPH_VIEW_H_
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "graph.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// A read-only view of a graph that hides some of its vertices and edges.
+///
+/// Nothing is copied: the view refers to the graph and skips what it hides
+/// while iterating. A vertex is kept when keep_vertex(vd) holds, and an edge
+/// when both of its ends are kept and keep_edge(ed, property) holds. The
+/// view offers the read side of graph's interface: vertex and edge
+/// iteration, find_vertex and find_edge, and per-vertex adjacency iterators
+/// that skip hidden edges. So csr_graph snapshots and the map-based
+/// algorithms (BFS, Dijkstra's, Kruskal's, ...) run on it unchanged, and
+/// clone() turns it into a graph of its own.
+///
+/// The view sees later changes to the graph, but its iterators are
+/// invalidated by them the way the graph's own are. num_vertices() and
+/// num_edges() count with a pass over the graph every time they are asked,
+/// since the graph or what the filters keep may have changed since.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Graph, typename VertexFilter, typename EdgeFilter>
+class filtered_graph {
+
+    typedef typename std::remove_pointer<
+        typename Graph::MyVertexContainer::mapped_type>::type vertex_type;
+    typedef typename std::remove_pointer<
+        typename Graph::MyEdgeContainer::mapped_type>::type edge_type;
+
+  public:
+
+    typedef typename Graph::vertex_descriptor vertex_descriptor;
+    typedef typename Graph::edge_descriptor edge_descriptor;
+    typedef typename Graph::vertex_property vertex_property;
+    typedef typename Graph::edge_property edge_property;
+
+    /// Iterator over the entries of a graph map that the view keeps.
+    template<typename Base>
+    class filter_iterator {
+
+      public:
+
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef typename std::iterator_traits<Base>::value_type value_type;
+        typedef typename std::iterator_traits<Base>::difference_type
+            difference_type;
+        typedef typename std::iterator_traits<Base>::pointer pointer;
+        typedef typename std::iterator_traits<Base>::reference reference;
+
+        filter_iterator() : view(nullptr) {}
+        filter_iterator(const filtered_graph* v, Base i, Base e) :
+            view(v), it(i), end(e) {skip();}
+
+        reference operator*() const {return *it;}
+        pointer operator->() const {return &*it;}
+
+        filter_iterator& operator++() {
+            ++it;
+            skip();
+            return *this;
+        }
+
+        filter_iterator operator++(int) {
+            filter_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        // like the map's own, must not step back past the first entry kept
+        filter_iterator& operator--() {
+            do
+                --it;
+            while (!view->keeps(*it));
+            return *this;
+        }
+
+        filter_iterator operator--(int) {
+            filter_iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const filter_iterator& o) const {return it == o.it;}
+        bool operator!=(const filter_iterator& o) const {return it != o.it;}
+
+      private:
+
+        void skip() {
+            while (it != end && !view->keeps(*it))
+                ++it;
+        }
+
+        const filtered_graph* view;
+        Base it;
+        Base end;
+    };
+
+    typedef filter_iterator<typename Graph::const_adj_edge_iterator>
+        const_adj_edge_iterator;
+    typedef filter_iterator<typename Graph::const_edge_iterator>
+        const_edge_iterator;
+    typedef const_edge_iterator edge_iterator;
+
+    /// A kept vertex as the view shows it: adjacency iterators skip hidden
+    /// edges. Used through -> like the graph's vertex pointers.
+    class vertex_ref {
+
+      public:
+
+        vertex_ref() : v(nullptr), view(nullptr) {}
+        vertex_ref(vertex_type* v, const filtered_graph* view) :
+            v(v), view(view) {}
+
+        const vertex_ref* operator->() const {return this;}
+
+        const_adj_edge_iterator begin() const {
+            return const_adj_edge_iterator(view, v->cbegin(), v->cend());
+        }
+        const_adj_edge_iterator end() const {
+            return const_adj_edge_iterator(view, v->cend(), v->cend());
+        }
+        const_adj_edge_iterator cbegin() const {return begin();}
+        const_adj_edge_iterator cend() const {return end();}
+
+        vertex_descriptor descriptor() const {return v->descriptor();}
+        const vertex_property& property() const {return v->property();}
+
+        // labels belong to the graph's vertex, as for the graph itself
+        size_t get_label() const {return v->get_label();}
+        void set_label(size_t l) const {v->set_label(l);}
+
+      private:
+
+        vertex_type* v;
+        const filtered_graph* view;
+    };
+
+    /// Iterator over the kept vertices, as (descriptor, vertex_ref) pairs.
+    class vertex_iterator {
+
+        typedef typename Graph::const_vertex_iterator base;
+
+      public:
+
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<vertex_descriptor, vertex_ref> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        vertex_iterator() {}
+        vertex_iterator(const filtered_graph* v, base i, base e) :
+            it(v, i, e), view(v) {}
+
+        reference operator*() const {
+            current = value_type(it->first, vertex_ref(it->second, view));
+            return current;
+        }
+        pointer operator->() const {return &**this;}
+
+        vertex_iterator& operator++() {++it; return *this;}
+        vertex_iterator& operator--() {--it; return *this;}
+
+        vertex_iterator operator++(int) {
+            vertex_iterator old = *this;
+            ++it;
+            return old;
+        }
+
+        vertex_iterator operator--(int) {
+            vertex_iterator old = *this;
+            --it;
+            return old;
+        }
+
+        bool operator==(const vertex_iterator& o) const {return it == o.it;}
+        bool operator!=(const vertex_iterator& o) const {return it != o.it;}
+
+      private:
+
+        filter_iterator<base> it;
+        const filtered_graph* view;
+        mutable value_type current;
+    };
+
+    typedef vertex_iterator const_vertex_iterator;
+
+    filtered_graph(const Graph& g, VertexFilter keep_vertex,
+                   EdgeFilter keep_edge) :
+        g(g), keep_vertex(keep_vertex), keep_edge(keep_edge) {}
+
+    /// The graph the view looks at.
+    const Graph& base() const {return g;}
+
+    vertex_iterator vertices_begin() const {return vertices_cbegin();}
+    vertex_iterator vertices_end() const {return vertices_cend();}
+    vertex_iterator vertices_cbegin() const {
+        return vertex_iterator(this, g.vertices_cbegin(), g.vertices_cend());
+    }
+    vertex_iterator vertices_cend() const {
+        return vertex_iterator(this, g.vertices_cend(), g.vertices_cend());
+    }
+
+    edge_iterator edges_begin() const {return edges_cbegin();}
+    edge_iterator edges_end() const {return edges_cend();}
+    edge_iterator edges_cbegin() const {
+        return edge_iterator(this, g.edges_cbegin(), g.edges_cend());
+    }
+    edge_iterator edges_cend() const {
+        return edge_iterator(this, g.edges_cend(), g.edges_cend());
+    }
+
+    size_t num_vertices() const {
+        size_t count = 0;
+        for (auto v = vertices_cbegin(); v != vertices_cend(); ++v)
+            ++count;
+        return count;
+    }
+
+    size_t num_edges() const {
+        size_t count = 0;
+        for (auto e = edges_cbegin(); e != edges_cend(); ++e)
+            ++count;
+        return count;
+    }
+
+    vertex_iterator find_vertex(vertex_descriptor vd) const {
+        auto v = g.find_vertex(vd);
+        if (v == g.vertices_cend() || !keeps(*v))
+            return vertices_cend();
+        return vertex_iterator(this, v, g.vertices_cend());
+    }
+
+    edge_iterator find_edge(edge_descriptor ed) const {
+        auto e = g.find_edge(ed);
+        if (e == g.edges_cend() || !keeps(*e))
+            return edges_cend();
+        return edge_iterator(this, e, g.edges_cend());
+    }
+
+    /// A graph of its own holding what the view keeps, with the same
+    /// descriptors.
+    Graph clone() const {
+        Graph c;
+        c.copy_from(*this);
+        return c;
+    }
+
+    bool keeps(vertex_descriptor vd) const {return keep_vertex(vd);}
+
+    bool keeps(const std::pair<const vertex_descriptor, vertex_type*>& v)
+        const {
+        return keep_vertex(v.first);
+    }
+
+    bool keeps(const std::pair<const edge_descriptor, edge_type*>& e) const {
+        return keep_vertex(e.second->source()) &&
+               keep_vertex(e.second->target()) &&
+               keep_edge(e.first, e.second->property());
+    }
+
+  private:
+
+    const Graph& g;
+    VertexFilter keep_vertex;
+    EdgeFilter keep_edge;
+};
+
+// Filters that keep everything, for views that filter only one side.
+struct keep_all_vertices {
+    bool operator()(size_t) const {return true;}
+};
+
+struct keep_all_edges {
+    template<typename EdgeDescriptor, typename EdgeProperty>
+    bool operator()(const EdgeDescriptor&, const EdgeProperty&) const {
+        return true;
+    }
+};
+
+// Keeps the vertices in a set, by reference; any container with count().
+template<typename VertexSet>
+struct keep_vertex_set {
+    const VertexSet* set;
+    bool operator()(size_t vd) const {return set->count(vd) != 0;}
+};
+
+// The subgraph of g induced by the vertices in set: those vertices and the
+// edges between them. The view refers to set, which must outlive it.
+template<typename Graph, typename VertexSet>
+filtered_graph<Graph, keep_vertex_set<VertexSet>, keep_all_edges>
+induced_subgraph(const Graph& g, const VertexSet& set) {
+    keep_vertex_set<VertexSet> keep = {&set};
+    return filtered_graph<Graph, keep_vertex_set<VertexSet>, keep_all_edges>(
+        g, keep, keep_all_edges());
+}
+
+// g with only the edges for which keep(ed, property) holds.
+template<typename Graph, typename Predicate>
+filtered_graph<Graph, keep_all_vertices, Predicate>
+edge_filtered_view(const Graph& g, Predicate keep) {
+    return filtered_graph<Graph, keep_all_vertices, Predicate>(
+        g, keep_all_vertices(), keep);
+}
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef _MEMORY_USAGE_H_
+#define _MEMORY_USAGE_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// What the bytes of a graph are spent on.
+//
+//  - MEMORY_PROPERTIES: the vertex and edge properties themselves.
+//  - MEMORY_INDEX: the vertices and edges maps that find a vertex or edge by
+//    descriptor, and the descriptors and labels stored next to each
+//    property.
+//  - MEMORY_ADJACENCY: the per-vertex adj_edge maps.
+//  - MEMORY_SLACK: what malloc hands out beyond the bytes asked for, its
+//    chunk header and rounding, summed over all of the above. Only glibc
+//    reports it; elsewhere it stays 0 and the rest are the bytes asked for.
+//
+// Properties that own heap memory of their own, such as strings, are counted
+// by their sizeof only.
+enum MemoryCategory {MEMORY_PROPERTIES, MEMORY_INDEX, MEMORY_ADJACENCY,
+                     MEMORY_SLACK, MEMORY_CATEGORIES};
+
+// Live bytes of one graph by category, and the most it ever held.
+struct memory_report {
+    size_t properties;
+    size_t index;
+    size_t adjacency;
+    size_t slack;
+    size_t peak;            ///< Highest total since the graph was created.
+    size_t allocators;      ///< Part of the total spent on allocator state,
+                            ///< which only the accounting itself adds.
+
+    size_t total() const {return properties + index + adjacency + slack;}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Running byte counts of one graph's allocations. Every allocation the
+/// graph makes is reported here, with the category it belongs to and the
+/// slack malloc added to it, so the counts are exact rather than estimated.
+/// The account takes its memory from malloc itself, so the slack it reads
+/// back is that of its own blocks whatever operator new has been replaced
+/// with. Like graph, an account is not safe to update from several threads.
+////////////////////////////////////////////////////////////////////////////////
+class memory_account {
+
+  public:
+
+    memory_account() : high(0) {
+        for (size_t i = 0; i < MEMORY_CATEGORIES; ++i)
+            live[i] = 0;
+    }
+
+    memory_account(const memory_account&) = delete;
+    memory_account& operator=(const memory_account&) = delete;
+
+    /// Allocate bytes for category c from malloc, and count them.
+    void* allocate(MemoryCategory c, size_t bytes) {
+        void* p = std::malloc(bytes == 0 ? 1 : bytes);
+        if (p == nullptr)
+            throw std::bad_alloc();
+        live[c] += bytes;
+        live[MEMORY_SLACK] += slack(p, bytes);
+        size_t now = total();
+        if (now > high)
+            high = now;
+        return p;
+    }
+
+    /// Return p, allocated for category c, to malloc.
+    void deallocate(MemoryCategory c, void* p, size_t bytes) {
+        live[c] -= bytes;
+        live[MEMORY_SLACK] -= slack(p, bytes);
+        std::free(p);
+    }
+
+    /// Count bytes already counted under from under to instead, for objects
+    /// that hold parts of several categories.
+    void recount(MemoryCategory from, MemoryCategory to, size_t bytes) {
+        live[from] -= bytes;
+        live[to] += bytes;
+    }
+
+    size_t bytes(MemoryCategory c) const {return live[c];}
+    size_t peak() const {return high;}
+
+    size_t total() const {
+        size_t sum = 0;
+        for (size_t i = 0; i < MEMORY_CATEGORIES; ++i)
+            sum += live[i];
+        return sum;
+    }
+
+    memory_report report() const {
+        memory_report r;
+        r.properties = live[MEMORY_PROPERTIES];
+        r.index = live[MEMORY_INDEX];
+        r.adjacency = live[MEMORY_ADJACENCY];
+        r.slack = live[MEMORY_SLACK];
+        r.peak = high;
+        r.allocators = 0;
+        return r;
+    }
+
+  private:
+
+    // glibc hands out usable_size bytes after a one-word chunk header
+    static size_t slack(void* p, size_t bytes) {
+#ifdef __GLIBC__
+        return malloc_usable_size(p) + sizeof(size_t) - bytes;
+#else
+        (void)p;
+        (void)bytes;
+        return 0;
+#endif
+    }
+
+    size_t live[MEMORY_CATEGORIES];
+    size_t high;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// A standard allocator that takes its memory through a memory_account,
+/// counting it under one category. Containers rebind it to their node types,
+/// so a map's nodes are counted at their real size. The allocator travels
+/// with the nodes when containers are swapped or assigned, so each node is
+/// always returned to the account it was taken from.
+////////////////////////////////////////////////////////////////////////////////
+template<typename T>
+class tracking_allocator {
+
+  public:
+
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    tracking_allocator(memory_account* a, MemoryCategory c) :
+        account(a), category(c) {}
+
+    template<typename U>
+    tracking_allocator(const tracking_allocator<U>& o) :
+        account(o.account), category(o.category) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(account->allocate(category, n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        account->deallocate(category, p, n * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator==(const tracking_allocator<U>& o) const {
+        return account == o.account && category == o.category;
+    }
+
+    template<typename U>
+    bool operator!=(const tracking_allocator<U>& o) const {
+        return !(*this == o);
+    }
+
+    memory_account* account;
+    MemoryCategory category;
+};
+
+#endif
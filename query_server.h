@@ -0,0 +1,664 @@
+#ifndef _QUERY_SERVER_H_
+#define _QUERY_SERVER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "csr_graph.h"
+#include "graph_algorithms.h"
+#include "scheduler.h"
+#include "sharded_sssp.h"
+
+// Asynchronous BFS, SSSP and reachability queries over one read-only
+// snapshot of a graph.
+//
+// Callers submit queries from any thread and get a std::future for each
+// answer. A dispatcher thread takes everything queued at once. BFS and
+// reachability queries from the whole intake are merged by source and run
+// as multi-source BFS batches of up to 256 sources, fewer on graphs large
+// enough that 256 rows would pass 64 MB. Each SSSP query runs as its own
+// Dijkstra search. Batches and searches are spread over the shared
+// work-stealing scheduler, on as many threads as the server was given.
+// Queries that arrive while a round runs wait for the next one, so batches
+// grow with the load. The queue is bounded: once max_pending queries are
+// waiting, submissions are refused until the dispatcher catches up, and
+// callers should back off and retry.
+//
+// query_socket_server serves the same queries over a Unix socket, and
+// query_socket_client talks to it. Linux only, like sharded_sssp.
+
+enum QueryKind {BFS_QUERY, SSSP_QUERY, REACH_QUERY};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Latency histogram with power-of-two buckets: bucket i counts latencies in
+/// [2^i, 2^(i+1)) microseconds, and bucket 0 also takes everything shorter.
+/// Safe to record into from several threads.
+////////////////////////////////////////////////////////////////////////////////
+class latency_histogram {
+
+  public:
+
+    static const size_t buckets = 32;
+
+    latency_histogram() {
+        for (size_t i = 0; i < buckets; ++i)
+            counts[i] = 0;
+    }
+
+    /// Record one latency, given in nanoseconds.
+    void record(double ns) {
+        size_t us = size_t(ns / 1000);
+        size_t i = 0;
+        while (us > 1 && i + 1 < buckets) {
+            us >>= 1;
+            ++i;
+        }
+        counts[i].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t count() const {
+        size_t total = 0;
+        for (size_t i = 0; i < buckets; ++i)
+            total += bucket(i);
+        return total;
+    }
+
+    size_t bucket(size_t i) const {
+        return counts[i].load(std::memory_order_relaxed);
+    }
+
+    /// Upper bound in microseconds on the p-th fraction of latencies, for p
+    /// in [0, 1]; 0 when nothing was recorded.
+    double percentile(double p) const {
+        size_t total = count();
+        if (total == 0)
+            return 0;
+        size_t seen = 0;
+        for (size_t i = 0; i < buckets; ++i) {
+            seen += bucket(i);
+            if (seen >= p * total)
+                return double(size_t(2) << i);
+        }
+        return double(size_t(2) << (buckets - 1));
+    }
+
+  private:
+
+    std::atomic<size_t> counts[buckets];
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Batched asynchronous query server; see the top of this file.
+///
+/// Answers are indexed by dense vertex index in snapshot(). A BFS answer
+/// holds the hop count of every vertex, or csr_graph::npos where it is
+/// unreached. An SSSP answer holds the distance of every vertex, with the
+/// weight type's max() where it is unreached. A query from a vertex that is
+/// not in the graph gets an empty answer, or false for reachability.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Graph>
+class query_server {
+
+  public:
+
+    typedef typename Graph::vertex_descriptor vertex_descriptor;
+    typedef typename Graph::edge_property weight;
+
+    /// Snapshot g and start serving. Each round runs on at most threads
+    /// threads of scheduler::global() (0 for all of them).
+    explicit query_server(const Graph& g, size_t threads = 0,
+                          size_t max_pending = 4096) :
+        csr(g), thread_cap(threads), limit(max_pending), paused(false),
+        stopping(false), refused(0), done(0), rounds(0), batched_queries(0) {
+        dispatcher = std::thread(&query_server::dispatch, this);
+    }
+
+    /// Answers every query already accepted, then stops.
+    ~query_server() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        dispatcher.join();
+    }
+
+    query_server(const query_server&) = delete;
+    query_server& operator=(const query_server&) = delete;
+
+    /// Queue a BFS from s. Returns false, leaving hops alone, if the queue
+    /// is full.
+    bool bfs(vertex_descriptor s, std::future<std::vector<size_t> >& hops) {
+        pending q(BFS_QUERY, csr.index(s), 0);
+        std::future<std::vector<size_t> > f = q.hops.get_future();
+        if (q.source == csr.npos) {
+            q.hops.set_value(std::vector<size_t>());
+        } else if (!submit(q)) {
+            return false;
+        }
+        hops = std::move(f);
+        return true;
+    }
+
+    /// Queue single-source shortest paths from s. Returns false, leaving
+    /// dist alone, if the queue is full.
+    bool sssp(vertex_descriptor s, std::future<std::vector<weight> >& dist) {
+        pending q(SSSP_QUERY, csr.index(s), 0);
+        std::future<std::vector<weight> > f = q.dist.get_future();
+        if (q.source == csr.npos) {
+            q.dist.set_value(std::vector<weight>());
+        } else if (!submit(q)) {
+            return false;
+        }
+        dist = std::move(f);
+        return true;
+    }
+
+    /// Queue the question whether t can be reached from s. Returns false,
+    /// leaving reached alone, if the queue is full.
+    bool reachable(vertex_descriptor s, vertex_descriptor t,
+                   std::future<bool>& reached) {
+        pending q(REACH_QUERY, csr.index(s), csr.index(t));
+        std::future<bool> f = q.reached.get_future();
+        if (q.source == csr.npos || q.target == csr.npos) {
+            q.reached.set_value(false);
+        } else if (!submit(q)) {
+            return false;
+        }
+        reached = std::move(f);
+        return true;
+    }
+
+    /// Stop and restart taking queries off the queue. Submissions are still
+    /// accepted while paused, up to max_pending.
+    void pause() {
+        std::lock_guard<std::mutex> guard(lock);
+        paused = true;
+    }
+
+    void resume() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            paused = false;
+        }
+        wake.notify_all();
+    }
+
+    /// The snapshot that answers are indexed by.
+    const csr_graph<Graph>& snapshot() const {return csr;}
+
+    /// Time from submission to answer for each kind of query.
+    const latency_histogram& latency(QueryKind kind) const {
+        return histograms[kind];
+    }
+
+    size_t rejected() const {return refused;}   ///< Submissions refused.
+    size_t completed() const {return done;}     ///< Queries answered.
+    size_t batches() const {return rounds;}     ///< MS-BFS batches run.
+    size_t batched() const {return batched_queries;} ///< Queries in them.
+
+  private:
+
+    typedef std::chrono::steady_clock clock;
+
+    // A submitted query; only the promise of its kind is used.
+    struct pending {
+        QueryKind kind;
+        size_t source;
+        size_t target;
+        clock::time_point submitted;
+        std::promise<std::vector<size_t> > hops;
+        std::promise<std::vector<weight> > dist;
+        std::promise<bool> reached;
+
+        pending(QueryKind k, size_t s, size_t t) :
+            kind(k), source(s), target(t), submitted(clock::now()) {}
+    };
+
+    bool submit(pending& q) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (queue.size() >= limit) {
+                ++refused;
+                return false;
+            }
+            queue.push_back(std::move(q));
+        }
+        wake.notify_one();
+        return true;
+    }
+
+    void finish(pending& q) {
+        std::chrono::duration<double, std::nano> took =
+            clock::now() - q.submitted;
+        histograms[q.kind].record(took.count());
+        ++done;
+    }
+
+    // Dispatcher thread: take the whole queue, answer it, repeat. Stopping
+    // overrides pause so that nothing accepted goes unanswered.
+    void dispatch() {
+        while (true) {
+            std::deque<pending> intake;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] {
+                    return stopping || (!paused && !queue.empty());
+                });
+                if (queue.empty())
+                    return;
+                intake.swap(queue);
+            }
+            answer(intake);
+        }
+    }
+
+    void answer(std::deque<pending>& intake) {
+        // hop queries share one BFS row per distinct source
+        std::vector<size_t> sources;
+        std::unordered_map<size_t, size_t> row;
+        std::vector<pending*> searches;
+        for (size_t i = 0; i < intake.size(); ++i) {
+            if (intake[i].kind == SSSP_QUERY) {
+                searches.push_back(&intake[i]);
+            } else if (row.insert(std::make_pair(intake[i].source,
+                                                 sources.size())).second) {
+                sources.push_back(intake[i].source);
+            }
+        }
+
+        // a batch holds two n-entry rows per source; keep it near 64 MB
+        const size_t n = csr.num_vertices();
+        const size_t row_bytes = 2 * sizeof(size_t) * std::max<size_t>(1, n);
+        const size_t width = std::max<size_t>(1, std::min<size_t>(256,
+                                 (size_t(64) << 20) / row_bytes));
+        size_t chunks = (sources.size() + width - 1) / width;
+        std::vector<std::vector<size_t> > hops(chunks);
+        parallel_for(0, chunks + searches.size(), 1,
+            [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    if (i < chunks) {
+                        size_t first = i * width;
+                        size_t last = std::min(first + width, sources.size());
+                        std::vector<size_t> batch(sources.begin() + first,
+                                                  sources.begin() + last);
+                        std::vector<size_t> parents;
+                        multi_source_bfs_dense(csr, batch, hops[i], parents);
+                    } else {
+                        pending& q = *searches[i - chunks];
+                        std::vector<weight> dist;
+                        dijkstra(q.source, dist);
+                        q.dist.set_value(std::move(dist));
+                        finish(q);
+                    }
+                }
+            }, thread_cap);
+
+        for (size_t i = 0; i < intake.size(); ++i) {
+            pending& q = intake[i];
+            if (q.kind == SSSP_QUERY)
+                continue;
+            size_t r = row[q.source];
+            const size_t* d = hops[r / width].data() + (r % width) * n;
+            if (q.kind == BFS_QUERY)
+                q.hops.set_value(std::vector<size_t>(d, d + n));
+            else
+                q.reached.set_value(d[q.target] != csr.npos);
+            finish(q);
+        }
+        rounds += chunks;
+        batched_queries += intake.size() - searches.size();
+    }
+
+    void dijkstra(size_t source, std::vector<weight>& dist) const {
+        typedef std::pair<weight, size_t> entry;
+        std::priority_queue<entry, std::vector<entry>,
+                            std::greater<entry> > q;
+        dist.assign(csr.num_vertices(), std::numeric_limits<weight>::max());
+        dist[source] = weight(0);
+        q.push(entry(weight(0), source));
+        while (!q.empty()) {
+            entry top = q.top();
+            q.pop();
+            if (dist[top.second] < top.first)
+                continue;
+            const weight* w = csr.weights_begin(top.second);
+            for (const size_t* u = csr.neighbors_begin(top.second);
+                 u != csr.neighbors_end(top.second); ++u, ++w) {
+                weight nd = top.first + *w;
+                if (nd < dist[*u]) {
+                    dist[*u] = nd;
+                    q.push(entry(nd, *u));
+                }
+            }
+        }
+    }
+
+    const csr_graph<Graph> csr;
+    const size_t thread_cap;         // threads per round, 0 for all
+    const size_t limit;
+
+    std::mutex lock;                 // guards queue, paused and stopping
+    std::condition_variable wake;
+    std::deque<pending> queue;
+    bool paused;
+    bool stopping;
+    std::thread dispatcher;
+
+    latency_histogram histograms[3];
+    std::atomic<size_t> refused;
+    std::atomic<size_t> done;
+    std::atomic<size_t> rounds;
+    std::atomic<size_t> batched_queries;
+};
+
+// Wire format of the socket stand-in. A request is one query_request; the
+// reply is a query_reply followed by count query_entry records, which hold
+// (descriptor, hops) for BFS, (descriptor, distance) for SSSP, and nothing
+// for reachability, whose answer is count itself.
+struct query_request {
+    uint64_t kind;
+    uint64_t source;
+    uint64_t target;
+};
+
+enum QueryStatus {QUERY_OK, QUERY_BUSY, QUERY_BAD};
+
+struct query_reply {
+    uint64_t status;
+    uint64_t count;
+};
+
+template<typename Value>
+struct query_entry {
+    uint64_t vertex;
+    Value value;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Serves a query_server on a Unix socket at path, with one thread per
+/// connection answering its requests in order. Refused submissions are
+/// answered with QUERY_BUSY. A connection's socket is closed when its
+/// client hangs up, and its thread is joined on the next accept. Check ok()
+/// after construction.
+///
+/// The destructor resumes the query server if it is paused: a connection
+/// waiting on an answer could not finish otherwise.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Graph>
+class query_socket_server {
+
+  public:
+
+    query_socket_server(query_server<Graph>& s, const std::string& path) :
+        server(s), name(path), listener(-1), stopping(false) {
+        sockaddr_un addr;
+        if (path.size() >= sizeof(addr.sun_path))
+            return;
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, path.size());
+        addr.sun_path[path.size()] = '\0';
+
+        unlink(path.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0)
+            return;
+        if (bind(listener, reinterpret_cast<sockaddr*>(&addr),
+                 sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+            close(listener);
+            listener = -1;
+            return;
+        }
+        acceptor = std::thread(&query_socket_server::accept_loop, this);
+    }
+
+    ~query_socket_server() {
+        stopping = true;
+        if (listener >= 0) {
+            // wakes the acceptor, which then takes no more connections
+            shutdown(listener, SHUT_RDWR);
+            acceptor.join();
+            close(listener);
+            unlink(name.c_str());
+        }
+
+        // wake the connections blocked in read, and answer those waiting on
+        // a future; each one closes its own socket on the way out
+        server.resume();
+        std::vector<std::thread> running;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (size_t i = 0; i < connections.size(); ++i)
+                shutdown(connections[i], SHUT_RDWR);
+            running.swap(handlers);
+        }
+        for (size_t i = 0; i < running.size(); ++i)
+            running[i].join();
+    }
+
+    query_socket_server(const query_socket_server&) = delete;
+    query_socket_server& operator=(const query_socket_server&) = delete;
+
+    bool ok() const {return listener >= 0;}
+
+    /// Connections currently open.
+    size_t open_connections() {
+        std::lock_guard<std::mutex> guard(lock);
+        return connections.size();
+    }
+
+  private:
+
+    typedef typename Graph::vertex_descriptor vertex_descriptor;
+    typedef typename Graph::edge_property weight;
+
+    void accept_loop() {
+        while (!stopping) {
+            int fd = accept(listener, 0, 0);
+            if (fd < 0)
+                return;
+            std::lock_guard<std::mutex> guard(lock);
+            reap();
+            connections.push_back(fd);
+            handlers.push_back(
+                std::thread(&query_socket_server::serve, this, fd));
+        }
+    }
+
+    // Join the handlers that have finished. Called with lock held.
+    void reap() {
+        for (size_t i = 0; i < finished.size(); ++i)
+            for (size_t j = 0; j < handlers.size(); ++j)
+                if (handlers[j].get_id() == finished[i]) {
+                    handlers[j].join();
+                    handlers.erase(handlers.begin() + j);
+                    break;
+                }
+        finished.clear();
+    }
+
+    // Answer the requests on fd until the client hangs up, then close it.
+    void serve(int fd) {
+        answer(fd);
+        std::lock_guard<std::mutex> guard(lock);
+        connections.erase(std::find(connections.begin(), connections.end(),
+                                    fd));
+        close(fd);
+        finished.push_back(std::this_thread::get_id());
+    }
+
+    void answer(int fd) {
+        const csr_graph<Graph>& csr = server.snapshot();
+        query_request r;
+        while (sharded_read(fd, &r, sizeof(r))) {
+            query_reply reply = {QUERY_OK, 0};
+            bool ok = true;
+            if (r.kind == BFS_QUERY) {
+                std::future<std::vector<size_t> > f;
+                if (!server.bfs(r.source, f)) {
+                    reply.status = QUERY_BUSY;
+                    ok = sharded_write(fd, &reply, sizeof(reply));
+                } else {
+                    std::vector<query_entry<uint64_t> > out;
+                    std::vector<size_t> hops = f.get();
+                    for (size_t v = 0; v < hops.size(); ++v)
+                        if (hops[v] != csr.npos) {
+                            query_entry<uint64_t> e = {csr.descriptor(v),
+                                                       hops[v]};
+                            out.push_back(e);
+                        }
+                    ok = send_entries(fd, out);
+                }
+            } else if (r.kind == SSSP_QUERY) {
+                std::future<std::vector<weight> > f;
+                if (!server.sssp(r.source, f)) {
+                    reply.status = QUERY_BUSY;
+                    ok = sharded_write(fd, &reply, sizeof(reply));
+                } else {
+                    std::vector<query_entry<weight> > out;
+                    std::vector<weight> dist = f.get();
+                    for (size_t v = 0; v < dist.size(); ++v)
+                        if (dist[v] != std::numeric_limits<weight>::max()) {
+                            query_entry<weight> e = {csr.descriptor(v),
+                                                     dist[v]};
+                            out.push_back(e);
+                        }
+                    ok = send_entries(fd, out);
+                }
+            } else if (r.kind == REACH_QUERY) {
+                std::future<bool> f;
+                if (!server.reachable(r.source, r.target, f))
+                    reply.status = QUERY_BUSY;
+                else
+                    reply.count = f.get() ? 1 : 0;
+                ok = sharded_write(fd, &reply, sizeof(reply));
+            } else {
+                reply.status = QUERY_BAD;
+                ok = sharded_write(fd, &reply, sizeof(reply));
+            }
+            if (!ok)
+                return;
+        }
+    }
+
+    template<typename Value>
+    static bool send_entries(int fd,
+                             const std::vector<query_entry<Value> >& out) {
+        query_reply reply = {QUERY_OK, out.size()};
+        return sharded_write(fd, &reply, sizeof(reply)) &&
+               sharded_write(fd, out.data(), out.size() * sizeof(out[0]));
+    }
+
+    query_server<Graph>& server;
+    std::string name;
+    int listener;
+    std::atomic<bool> stopping;
+    std::thread acceptor;
+    std::mutex lock;                 // guards the three below
+    std::vector<int> connections;    // sockets still open
+    std::vector<std::thread> handlers;
+    std::vector<std::thread::id> finished;  // handlers done but not joined
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// Client for query_socket_server. Each call sends one query and waits for
+/// its answer. Calls return false if the connection failed or the server
+/// was busy; busy() tells the two apart.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Weight>
+class query_socket_client {
+
+  public:
+
+    explicit query_socket_client(const std::string& path) :
+        fd(-1), was_busy(false) {
+        sockaddr_un addr;
+        if (path.size() >= sizeof(addr.sun_path))
+            return;
+        addr.sun_family = AF_UNIX;
+        path.copy(addr.sun_path, path.size());
+        addr.sun_path[path.size()] = '\0';
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr),
+                               sizeof(addr)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    ~query_socket_client() {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    query_socket_client(const query_socket_client&) = delete;
+    query_socket_client& operator=(const query_socket_client&) = delete;
+
+    bool ok() const {return fd >= 0;}
+    bool busy() const {return was_busy;}
+
+    /// Hop counts of the vertices reachable from source.
+    bool bfs(size_t source, std::vector<query_entry<uint64_t> >& hops) {
+        return ask(BFS_QUERY, source, 0, hops);
+    }
+
+    /// Distances of the vertices reachable from source.
+    bool sssp(size_t source, std::vector<query_entry<Weight> >& dist) {
+        return ask(SSSP_QUERY, source, 0, dist);
+    }
+
+    bool reachable(size_t source, size_t target, bool& reached) {
+        query_reply reply;
+        if (!request(REACH_QUERY, source, target, reply))
+            return false;
+        reached = reply.count != 0;
+        return true;
+    }
+
+  private:
+
+    bool request(QueryKind kind, size_t source, size_t target,
+                 query_reply& reply) {
+        was_busy = false;
+        query_request r = {uint64_t(kind), source, target};
+        if (fd < 0 || !sharded_write(fd, &r, sizeof(r)) ||
+            !sharded_read(fd, &reply, sizeof(reply)))
+            return false;
+        was_busy = reply.status == QUERY_BUSY;
+        return reply.status == QUERY_OK;
+    }
+
+    template<typename Value>
+    bool ask(QueryKind kind, size_t source, size_t target,
+             std::vector<query_entry<Value> >& out) {
+        query_reply reply;
+        if (!request(kind, source, target, reply))
+            return false;
+        out.resize(reply.count);
+        return sharded_read(fd, out.data(), out.size() * sizeof(out[0]));
+    }
+
+    int fd;
+    bool was_busy;
+};
+
+#endif
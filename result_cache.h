@@ -0,0 +1,253 @@
+#ifndef _RESULT_CACHE_H_
+#define _RESULT_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "graph_algorithms.h"
+
+// Algorithms whose results can be cached. Callers may use their own ids
+// from CACHED_USER on.
+enum CachedAlgorithm {CACHED_BFS, CACHED_KRUSKAL, CACHED_SSSP, CACHED_USER};
+
+// Approximate heap bytes held by a result, counting node and bucket
+// overhead the way libstdc++ lays them out.
+template<typename K, typename V, typename C, typename A>
+size_t result_bytes(const std::map<K, V, C, A>& m) {
+    // a red-black node holds three links and a color next to the value
+    return sizeof(m) + m.size() * (4 * sizeof(void*) +
+                                   sizeof(typename std::map<K, V, C, A>::
+                                          value_type));
+}
+
+template<typename K, typename V, typename C, typename A>
+size_t result_bytes(const std::multimap<K, V, C, A>& m) {
+    return sizeof(m) + m.size() * (4 * sizeof(void*) +
+                                   sizeof(typename std::multimap<K, V, C, A>::
+                                          value_type));
+}
+
+template<typename K, typename V, typename H, typename P, typename A>
+size_t result_bytes(const std::unordered_map<K, V, H, P, A>& m) {
+    // a hash node holds a link and the value; each bucket is one pointer
+    return sizeof(m) + m.bucket_count() * sizeof(void*) +
+           m.size() * (2 * sizeof(void*) +
+                       sizeof(typename std::unordered_map<K, V, H, P, A>::
+                              value_type));
+}
+
+template<typename T, typename A>
+size_t result_bytes(const std::vector<T, A>& v) {
+    return sizeof(v) + v.capacity() * sizeof(T);
+}
+
+template<typename T, typename U>
+size_t result_bytes(const std::pair<T, U>& p) {
+    return result_bytes(p.first) + result_bytes(p.second);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// A least-recently-used cache of algorithm results on one graph.
+///
+/// Results are keyed by (algorithm, source, epoch), where epoch is the
+/// graph's mutation epoch when the result was computed. Any insert or erase
+/// on the graph moves its epoch on, and the next lookup drops every entry
+/// from an earlier epoch, so a stale result is never returned. The cache
+/// holds at most budget bytes of results, measured by result_bytes; when a
+/// new result would pass the budget, the least recently used ones are
+/// evicted, and a result larger than the whole budget is not kept at all.
+///
+/// Results are handed out as shared pointers, so a caller may keep one after
+/// it has been evicted or invalidated. Like graph, the cache is not safe to
+/// use from several threads at once.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Graph, typename Result>
+class result_cache {
+
+  public:
+
+    explicit result_cache(const Graph& g, size_t budget = 64 << 20) :
+        g(g), limit(budget), seen(g.epoch()) {}
+
+    result_cache(const result_cache&) = delete;
+    result_cache& operator=(const result_cache&) = delete;
+
+    /// The cached result of algorithm from source at the graph's current
+    /// epoch, or null. Counts a hit or a miss.
+    std::shared_ptr<const Result> find(size_t algorithm, size_t source) {
+        refresh();
+        auto i = index.find(key{algorithm, source, seen});
+        if (i == index.end()) {
+            ++misses;
+            return std::shared_ptr<const Result>();
+        }
+        ++hits;
+        // move the entry to the front of the recency list
+        order.splice(order.begin(), order, i->second);
+        return i->second->result;
+    }
+
+    /// Cache r as the result of algorithm from source at the graph's current
+    /// epoch, replacing any earlier one, and return it.
+    std::shared_ptr<const Result> insert(size_t algorithm, size_t source,
+                                         Result&& r) {
+        refresh();
+        key k{algorithm, source, seen};
+        auto old = index.find(k);
+        if (old != index.end())
+            erase(old->second);
+
+        size_t size = result_bytes(r) + entry_overhead;
+        std::shared_ptr<const Result> p =
+            std::make_shared<const Result>(std::move(r));
+        if (size > limit)
+            return p;
+        while (used + size > limit)
+            evict();
+        order.push_front(entry{k, p, size});
+        index[k] = order.begin();
+        used += size;
+        return p;
+    }
+
+    /// The result of algorithm from source, running compute(result) to fill
+    /// it in on a miss.
+    template<typename F>
+    std::shared_ptr<const Result> get(size_t algorithm, size_t source,
+                                      F compute) {
+        std::shared_ptr<const Result> p = find(algorithm, source);
+        if (p)
+            return p;
+        Result r;
+        compute(r);
+        return insert(algorithm, source, std::move(r));
+    }
+
+    /// Drop every entry; the statistics are kept.
+    void clear() {
+        order.clear();
+        index.clear();
+        used = 0;
+    }
+
+    size_t size() const {return order.size();}     ///< Entries held.
+    size_t bytes() const {return used;}            ///< Bytes held.
+    size_t budget() const {return limit;}          ///< Most bytes held.
+    size_t hit_count() const {return hits;}        ///< Lookups answered.
+    size_t miss_count() const {return misses;}     ///< Lookups not answered.
+    size_t evictions() const {return evicted;}     ///< Entries evicted.
+    size_t invalidations() const {return stale;}   ///< Entries gone stale.
+
+    /// Fraction of lookups answered from the cache, 0 before any lookup.
+    double hit_rate() const {
+        return hits + misses == 0 ? 0.0 : double(hits) / (hits + misses);
+    }
+
+  private:
+
+    struct key {
+        size_t algorithm;
+        size_t source;
+        size_t epoch;
+
+        bool operator==(const key& o) const {
+            return algorithm == o.algorithm && source == o.source &&
+                   epoch == o.epoch;
+        }
+    };
+
+    struct key_hash {
+        size_t operator()(const key& k) const {
+            size_t h = k.source * 0x9E3779B97F4A7C15ull;
+            h ^= k.algorithm + 0x7F4A7C15 + (h << 6) + (h >> 2);
+            h ^= k.epoch + 0x7F4A7C15 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+
+    struct entry {
+        key k;
+        std::shared_ptr<const Result> result;
+        size_t size;
+    };
+
+    typedef typename std::list<entry>::iterator entry_iterator;
+
+    // bookkeeping per entry: its list node, index node and shared count
+    static const size_t entry_overhead = sizeof(entry) + 8 * sizeof(void*);
+
+    // drop every entry from an earlier epoch; all entries share one epoch,
+    // so that is all of them once the graph has changed
+    void refresh() {
+        if (g.epoch() == seen)
+            return;
+        stale += order.size();
+        clear();
+        seen = g.epoch();
+    }
+
+    void erase(entry_iterator i) {
+        used -= i->size;
+        index.erase(i->k);
+        order.erase(i);
+    }
+
+    void evict() {
+        entry_iterator last = order.end();
+        --last;
+        erase(last);
+        ++evicted;
+    }
+
+    const Graph& g;
+    size_t limit;
+    size_t seen;                        // epoch of every entry held
+    size_t used = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evicted = 0;
+    size_t stale = 0;
+    std::list<entry> order;             // most recently used first
+    std::unordered_map<key, entry_iterator, key_hash> index;
+};
+
+// BFS parent map from vd, through the cache. Like BFS, covers the vertices
+// reachable from vd, and vd itself gets no parent.
+template<typename Graph, typename ParentMap>
+std::shared_ptr<const ParentMap>
+cached_bfs(const Graph& g, result_cache<Graph, ParentMap>& cache,
+           typename Graph::vertex_descriptor vd) {
+    return cache.get(CACHED_BFS, vd, [&g, vd](ParentMap& p) {
+        for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v)
+            v->second->set_label(UNEXPLORED);
+        BFS(g, vd, p);
+    });
+}
+
+// Minimum spanning forest of g from mst_kruskals, through the cache.
+template<typename Graph, typename ParentMap>
+std::shared_ptr<const ParentMap>
+cached_mst_kruskals(const Graph& g, result_cache<Graph, ParentMap>& cache) {
+    return cache.get(CACHED_KRUSKAL, 0, [&g](ParentMap& p) {
+        mst_kruskals(g, p);
+    });
+}
+
+// Dijkstra distances and parents from vd, through the cache.
+template<typename Graph, typename ParentMap, typename DistanceMap>
+std::shared_ptr<const std::pair<ParentMap, DistanceMap> >
+cached_sssp(const Graph& g,
+            result_cache<Graph, std::pair<ParentMap, DistanceMap> >& cache,
+            typename Graph::vertex_descriptor vd) {
+    return cache.get(CACHED_SSSP, vd,
+                     [&g, vd](std::pair<ParentMap, DistanceMap>& r) {
+        sssp_dijkstras(g, vd, r.first, r.second);
+    });
+}
+
+#endif
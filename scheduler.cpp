@@ -0,0 +1,306 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+
+namespace {
+
+// The scheduler whose worker this thread is, and its index there.
+thread_local const scheduler* worker_of = nullptr;
+thread_local size_t worker_index = 0;
+
+// The slot of the range this thread is running.
+thread_local size_t current_slot = 0;
+
+// Parse a kernel CPU list such as "0-3,8,10-11".
+std::vector<int>
+parse_cpu_list(const std::string& s) {
+  std::vector<int> cpus;
+  const char* p = s.c_str();
+  while(*p) {
+    char* q;
+    long first = std::strtol(p, &q, 10);
+    if(q == p) break;
+    long last = first;
+    if(*q == '-')
+      last = std::strtol(q + 1, &q, 10);
+    for(long c = first; c <= last; ++c)
+      cpus.push_back(int(c));
+    p = *q == ',' ? q + 1 : q;
+  }
+  return cpus;
+}
+
+// The CPUs this process may run on, grouped by NUMA node. Without NUMA
+// information in sysfs, all of them form one node.
+std::vector<std::vector<int> >
+numa_nodes() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return std::vector<std::vector<int> >();
+
+  std::vector<std::vector<int> > nodes;
+  if(DIR* dir = opendir("/sys/devices/system/node")) {
+    std::vector<int> ids;
+    while(dirent* entry = readdir(dir)) {
+      int id;
+      char tail;
+      if(std::sscanf(entry->d_name, "node%d%c", &id, &tail) == 1)
+        ids.push_back(id);
+    }
+    closedir(dir);
+    std::sort(ids.begin(), ids.end());
+
+    for(size_t i = 0; i < ids.size(); ++i) {
+      std::string path = "/sys/devices/system/node/node" +
+                         std::to_string(ids[i]) + "/cpulist";
+      FILE* f = std::fopen(path.c_str(), "r");
+      if(!f) continue;
+      char line[4096] = {0};
+      if(std::fgets(line, sizeof(line), f)) {
+        std::vector<int> node;
+        std::vector<int> cpus = parse_cpu_list(line);
+        for(size_t c = 0; c < cpus.size(); ++c)
+          if(cpus[c] < CPU_SETSIZE && CPU_ISSET(cpus[c], &allowed))
+            node.push_back(cpus[c]);
+        if(!node.empty())
+          nodes.push_back(node);
+      }
+      std::fclose(f);
+    }
+  }
+
+  if(nodes.empty()) {
+    nodes.resize(1);
+    for(int c = 0; c < CPU_SETSIZE; ++c)
+      if(CPU_ISSET(c, &allowed))
+        nodes[0].push_back(c);
+  }
+  return nodes;
+}
+
+}
+
+
+size_t
+default_thread_count() {
+  return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+
+scheduler::
+scheduler(size_t threads, bool pin) {
+  if(threads == 0)
+    threads = default_thread_count();
+
+  // the last deque is shared by callers that are not workers
+  size_t count = threads - 1;
+  deques = std::vector<task_deque>(count + 1);
+  victims.assign(count + 1, std::vector<size_t>());
+  for(size_t i = 0; i <= count; ++i)
+    for(size_t k = 1; k <= count; ++k)
+      victims[i].push_back((i + k) % (count + 1));
+
+  // lay the CPUs out node by node; the caller keeps the first one to
+  // itself, and with fewer CPUs than threads placement is left to the OS
+  std::vector<int> cpus;
+  std::vector<size_t> node_of;
+  if(pin) {
+    std::vector<std::vector<int> > nodes = numa_nodes();
+    for(size_t n = 0; n < nodes.size(); ++n)
+      for(size_t c = 0; c < nodes[n].size(); ++c) {
+        cpus.push_back(nodes[n][c]);
+        node_of.push_back(n);
+      }
+    if(cpus.size() < threads)
+      cpus.clear();
+  }
+
+  // steal from the same node first, nearest index first
+  if(!cpus.empty())
+    for(size_t i = 0; i < count; ++i) {
+      size_t home = node_of[i + 1];
+      std::stable_partition(victims[i].begin(), victims[i].end(),
+          [&](size_t v) {return v < count && node_of[v + 1] == home;});
+    }
+
+  for(size_t i = 0; i < count; ++i) {
+    workers.emplace_back(&scheduler::work, this, i);
+    if(!cpus.empty()) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpus[i + 1], &set);
+      pthread_setaffinity_np(workers[i].native_handle(), sizeof(set), &set);
+    }
+  }
+}
+
+
+scheduler::
+~scheduler() {
+  {
+    std::lock_guard<std::mutex> guard(idle_lock);
+    stopping = true;
+  }
+  idle.notify_all();
+  for(size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+}
+
+
+scheduler&
+scheduler::
+global() {
+  static scheduler shared;
+  return shared;
+}
+
+
+size_t
+scheduler::
+slot() noexcept {
+  return current_slot;
+}
+
+
+size_t
+scheduler::
+enter_slot(size_t s) noexcept {
+  size_t outer = current_slot;
+  current_slot = s;
+  return outer;
+}
+
+
+size_t
+scheduler::
+self_index() const noexcept {
+  return worker_of == this ? worker_index : workers.size();
+}
+
+
+void
+scheduler::
+push(size_t self, const task& t) {
+  {
+    std::lock_guard<std::mutex> guard(deques[self].lock);
+    deques[self].tasks.push_back(t);
+  }
+  queued.fetch_add(1);
+  if(sleepers.load() != 0) {
+    std::lock_guard<std::mutex> guard(idle_lock);
+    idle.notify_one();
+  }
+}
+
+
+bool
+scheduler::
+take(task_deque& d, bool back, job* only, task& t) {
+  std::lock_guard<std::mutex> guard(d.lock);
+  size_t n = d.tasks.size();
+  for(size_t k = 0; k < n; ++k) {
+    size_t i = back ? n - 1 - k : k;
+    job* j = d.tasks[i].owner;
+    if(only && j != only)
+      continue;
+    // claim a place under the job's thread cap
+    size_t a = j->active.load();
+    while(a < j->limit && !j->active.compare_exchange_weak(a, a + 1)) {}
+    if(a >= j->limit)
+      continue;
+    t = d.tasks[i];
+    d.tasks.erase(d.tasks.begin() + i);
+    queued.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+
+bool
+scheduler::
+acquire(size_t self, job* only, task& t) {
+  if(take(deques[self], true, only, t))
+    return true;
+  for(size_t k = 0; k < victims[self].size(); ++k)
+    if(take(deques[victims[self][k]], false, only, t))
+      return true;
+  return false;
+}
+
+
+void
+scheduler::
+execute(task t, size_t self) {
+  job& j = *t.owner;
+  size_t outer = enter_slot(self);
+  while(t.end - t.begin > j.grain) {
+    size_t mid = t.begin + (t.end - t.begin) / 2;
+    push(self, task{&j, mid, t.end});
+    t.end = mid;
+  }
+  j.run(j.body, t.begin, t.end);
+  enter_slot(outer);
+  // the caller may return, and j go away, once remaining reaches 0
+  j.active.fetch_sub(1);
+  j.remaining.fetch_sub(t.end - t.begin);
+}
+
+
+void
+scheduler::
+run(job& j, size_t begin, size_t end) {
+  size_t self = self_index();
+  j.active = 1;
+  execute(task{&j, begin, end}, self);
+
+  // help with this job only, so slots stay unique within it
+  task t;
+  while(j.remaining.load() != 0) {
+    if(acquire(self, &j, t))
+      execute(t, self);
+    else
+      std::this_thread::yield();
+  }
+}
+
+
+void
+scheduler::
+work(size_t self) {
+  worker_of = this;
+  worker_index = self;
+
+  size_t misses = 0;
+  task t;
+  while(!stopping.load()) {
+    if(acquire(self, nullptr, t)) {
+      execute(t, self);
+      misses = 0;
+      continue;
+    }
+    if(++misses < 64) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // nothing to do: sleep until a push, or briefly when the waiting tasks
+    // all belong to jobs at their thread cap
+    std::unique_lock<std::mutex> guard(idle_lock);
+    sleepers.fetch_add(1);
+    if(queued.load() == 0)
+      idle.wait(guard, [this] {return stopping.load() || queued.load() != 0;});
+    else
+      idle.wait_for(guard, std::chrono::microseconds(200));
+    sleepers.fetch_sub(1);
+    misses = 0;
+  }
+}
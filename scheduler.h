@@ -0,0 +1,192 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of threads to use when a caller passes 0 for "all cores".
+size_t default_thread_count();
+
+////////////////////////////////////////////////////////////////////////////////
+/// A work-stealing task scheduler shared by the parallel graph algorithms.
+///
+/// A scheduler owns threads - 1 worker threads, started once and reused by
+/// every call. The thread that calls parallel_for always works too, so
+/// threads threads run in total. Each worker has its own deque of ranges.
+/// A thread running a range larger than the grain size splits it in half,
+/// pushes the upper half onto the back of its own deque and carries on with
+/// the lower half. Idle workers steal from the front of other deques, where
+/// the largest ranges wait, trying workers on their own NUMA node first.
+/// Workers are pinned to CPUs node by node, so neighboring workers share a
+/// node.
+///
+/// Each parallel_for may cap how many threads run its ranges at once. A
+/// thread waiting on a parallel_for runs only that call's ranges, so calls
+/// may nest and may come from several threads at once.
+////////////////////////////////////////////////////////////////////////////////
+class scheduler {
+
+  ///\name Local Types
+  ///@{
+
+  /// One parallel_for call: the loop body and its progress.
+  struct job {
+    void (*run)(void*, size_t, size_t); ///< Calls the body on a range.
+    void* body;                         ///< The type-erased body.
+    size_t grain;                       ///< Largest range run unsplit.
+    size_t limit;                       ///< Most threads running at once.
+    std::atomic<size_t> active;         ///< Threads running a range now.
+    std::atomic<size_t> remaining;      ///< Iterations not yet run.
+  };
+
+  /// A range of one job's iterations.
+  struct task {
+    job*   owner;
+    size_t begin;
+    size_t end;
+  };
+
+  /// A worker's deque: the owner takes from the back, thieves the front.
+  struct task_deque {
+    std::mutex       lock;
+    std::deque<task> tasks;
+  };
+
+  ///@}
+  ///\name Internal State
+  ///@{
+
+  std::vector<std::thread> workers;       ///< The worker threads.
+  std::vector<task_deque>  deques;        ///< One per worker, then one
+                                          ///< shared by outside callers.
+  std::vector<std::vector<size_t> > victims; ///< Steal order of each deque.
+  std::atomic<size_t>      queued{0};     ///< Tasks waiting in all deques.
+  std::atomic<size_t>      sleepers{0};   ///< Workers blocked on idle.
+  std::atomic<bool>        stopping{false}; ///< Set to shut workers down.
+  std::mutex               idle_lock;     ///< Guards idle waits.
+  std::condition_variable  idle;          ///< Wakes sleeping workers.
+
+  public:
+
+    ///@}
+    ///\name Construction
+    ///@{
+
+    /// Start a scheduler for threads threads in total (0 uses every core).
+    /// With pin, workers are bound to CPUs when there are enough of them.
+    explicit scheduler(size_t threads = 0, bool pin = true);
+    ~scheduler();
+
+    scheduler(const scheduler&) = delete;
+    scheduler& operator=(const scheduler&) = delete;
+
+    /// The scheduler shared by every algorithm, started on first use.
+    static scheduler& global();
+
+    ///@}
+    ///\name Interface
+    ///@{
+
+    /// Threads that can run a parallel_for at once, the caller included.
+    size_t num_threads() const noexcept {return workers.size() + 1;}
+
+    /// Inside a parallel_for body: a number in [0, num_threads()) that no
+    /// other thread running the same parallel_for has, for per-thread
+    /// scratch state.
+    static size_t slot() noexcept;
+
+    /// Call f(b, e) on disjoint ranges covering [begin, end), each at most
+    /// grain long, on up to threads threads (0 for all) at once. Returns
+    /// when every range has run.
+    template<typename F>
+    void parallel_for(size_t begin, size_t end, size_t grain, F f,
+                      size_t threads = 0) {
+      if (begin >= end)
+        return;
+      if (threads == 1 || workers.empty() || end - begin <= grain) {
+        // nothing to share out
+        run_serial(f, begin, end);
+        return;
+      }
+      job j;
+      j.run = &call<F>;
+      j.body = &f;
+      j.grain = grain == 0 ? 1 : grain;
+      j.limit = threads == 0 ? num_threads() : threads;
+      j.active = 0;
+      j.remaining = end - begin;
+      run(j, begin, end);
+    }
+
+    /// Combine map(b, e) over ranges covering [begin, end) with combine,
+    /// starting from identity. combine must be associative and commutative,
+    /// as the ranges finish in no fixed order.
+    template<typename T, typename Map, typename Combine>
+    T parallel_reduce(size_t begin, size_t end, size_t grain, T identity,
+                      Map map, Combine combine, size_t threads = 0) {
+      std::vector<T> partial(num_threads(), identity);
+      parallel_for(begin, end, grain,
+          [&partial, &map, &combine](size_t b, size_t e) {
+            T& mine = partial[slot()];
+            mine = combine(mine, map(b, e));
+          }, threads);
+      T total = identity;
+      for (size_t i = 0; i < partial.size(); ++i)
+        total = combine(total, partial[i]);
+      return total;
+    }
+
+    ///@}
+
+  private:
+
+    ///\name Helpers
+    ///@{
+
+    template<typename F>
+    static void call(void* body, size_t begin, size_t end) {
+      (*static_cast<F*>(body))(begin, end);
+    }
+
+    template<typename F>
+    static void run_serial(F& f, size_t begin, size_t end) {
+      size_t outer = enter_slot(0);
+      f(begin, end);
+      enter_slot(outer);
+    }
+
+    static size_t enter_slot(size_t s) noexcept; ///< Set slot(), return old.
+
+    void run(job& j, size_t begin, size_t end);  ///< Run j to completion.
+    void work(size_t self);                      ///< A worker's main loop.
+    void execute(task t, size_t self);           ///< Split and run t.
+    void push(size_t self, const task& t);
+    bool acquire(size_t self, job* only, task& t);
+    bool take(task_deque& d, bool back, job* only, task& t);
+    size_t self_index() const noexcept;          ///< This thread's deque.
+
+    ///@}
+};
+
+// Call f(b, e) over [begin, end) in ranges of at most grain on the shared
+// scheduler, using up to threads threads (0 uses every core).
+template<typename F>
+void parallel_for(size_t begin, size_t end, size_t grain, F f,
+                  size_t threads = 0) {
+    scheduler::global().parallel_for(begin, end, grain, f, threads);
+}
+
+// Reduce map(b, e) over [begin, end) with combine on the shared scheduler.
+template<typename T, typename Map, typename Combine>
+T parallel_reduce(size_t begin, size_t end, size_t grain, T identity,
+                  Map map, Combine combine, size_t threads = 0) {
+    return scheduler::global().parallel_reduce(begin, end, grain, identity,
+                                               map, combine, threads);
+}
+
+#endif
@@ -0,0 +1,361 @@
+#ifndef _SHARDED_SSSP_H_
+#define _SHARDED_SSSP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "graph_partition.h"
+
+// Multi-process BFS/SSSP over shard files written by write_shards().
+//
+// sharded_workers forks one worker per shard and talks to each over a Unix
+// socket pair; they are forked once, before any threads start, and serve
+// every search. Work proceeds in rounds. In each round the coordinator
+// hands every worker the distance updates addressed to its vertices. The
+// worker runs Dijkstra over its own vertices from the ones that improved and
+// replies with the improved distances of its ghost vertices. The coordinator
+// routes those replies to the owning shards for the next round, and stops
+// once a round produces no updates. This is Bellman-Ford across shards with
+// Dijkstra inside each shard, so it needs non-negative weights. BFS is the
+// same search with every edge weighing 1.
+//
+// Linux only: it relies on fork() and socketpair().
+
+// One distance update on the wire. shard names the owner of vertex.
+template<typename Weight>
+struct sharded_update {
+    uint64_t shard;
+    uint64_t vertex;
+    uint64_t parent;
+    Weight distance;
+};
+
+// Marks the message that ends the search and asks for the results
+const uint64_t sharded_finish = std::numeric_limits<uint64_t>::max();
+
+inline bool sharded_write(int fd, const void* buf, size_t len) {
+    const char* p = static_cast<const char*>(buf);
+    while (len > 0) {
+        // a dead peer must fail the write rather than raise SIGPIPE
+        ssize_t w = send(fd, p, len, MSG_NOSIGNAL);
+        if (w <= 0)
+            return false;
+        p += w;
+        len -= w;
+    }
+    return true;
+}
+
+inline bool sharded_read(int fd, void* buf, size_t len) {
+    char* p = static_cast<char*>(buf);
+    while (len > 0) {
+        ssize_t r = read(fd, p, len);
+        if (r <= 0)
+            return false;
+        p += r;
+        len -= r;
+    }
+    return true;
+}
+
+// A message is a record count followed by the records.
+template<typename Weight>
+bool sharded_send(int fd, const std::vector<sharded_update<Weight> >& m) {
+    uint64_t count = m.size();
+    return sharded_write(fd, &count, sizeof(count)) &&
+           sharded_write(fd, m.data(), m.size() * sizeof(m[0]));
+}
+
+// Receive a message into m. Returns false on a broken connection; a finish
+// message leaves finish set and m empty.
+template<typename Weight>
+bool sharded_receive(int fd, std::vector<sharded_update<Weight> >& m,
+                     bool& finish) {
+    uint64_t count = 0;
+    if (!sharded_read(fd, &count, sizeof(count)))
+        return false;
+    finish = count == sharded_finish;
+    m.resize(finish ? 0 : count);
+    return sharded_read(fd, m.data(), m.size() * sizeof(m[0]));
+}
+
+// Body of one worker process: serve searches on fd until the coordinator
+// closes it. Each search starts with a word that is 1 for unit weights and
+// runs rounds until the coordinator asks for the results. The shard is read
+// when the first search starts. Returns the process exit status.
+template<typename VertexProperty, typename EdgeProperty>
+int sharded_worker(int fd, const std::string& file) {
+    typedef EdgeProperty weight;
+    typedef sharded_update<weight> update;
+    typedef std::pair<weight, size_t> entry;
+
+    uint64_t unit_weights = 0;
+    if (!sharded_read(fd, &unit_weights, sizeof(unit_weights)))
+        return 0;
+
+    graph_shard<VertexProperty, EdgeProperty> s;
+    std::ifstream is(file.c_str());
+    is >> s;
+    if (!is)
+        return 1;
+
+    // local indices: owned vertices first, then ghosts
+    const size_t owned = s.vertices.size();
+    const size_t total = owned + s.ghosts.size();
+    std::vector<size_t> desc(total);
+    std::vector<size_t> ghost_owner(s.ghosts.size());
+    std::unordered_map<size_t, size_t> local;
+    for (size_t i = 0; i < owned; ++i) {
+        desc[i] = s.vertices[i].descriptor;
+        local[desc[i]] = i;
+    }
+    for (size_t i = 0; i < s.ghosts.size(); ++i) {
+        desc[owned + i] = s.ghosts[i].descriptor;
+        ghost_owner[i] = s.ghosts[i].owner;
+        local[desc[owned + i]] = owned + i;
+    }
+
+    std::vector<size_t> offsets(owned + 1, 0), targets(s.edges.size());
+    std::vector<weight> weights(s.edges.size());
+    for (size_t e = 0; e < s.edges.size(); ++e)
+        ++offsets[local[s.edges[e].source] + 1];
+    for (size_t i = 0; i < owned; ++i)
+        offsets[i + 1] += offsets[i];
+    std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+    for (size_t e = 0; e < s.edges.size(); ++e) {
+        size_t slot = next[local[s.edges[e].source]]++;
+        targets[slot] = local[s.edges[e].target];
+        weights[slot] = s.edges[e].property;
+    }
+
+    // a ghost's distance is the best one already sent to its owner
+    const weight infinity = std::numeric_limits<weight>::max();
+    std::vector<weight> dist;
+    std::vector<size_t> parent(total, 0);
+    std::vector<bool> dirty(s.ghosts.size(), false);
+    std::vector<update> in, out;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry> > pq;
+
+    do {
+        dist.assign(total, infinity);
+        bool finish = false;
+        while (true) {
+            if (!sharded_receive(fd, in, finish))
+                return 1;
+            if (finish)
+                break;
+
+            for (size_t i = 0; i < in.size(); ++i) {
+                auto l = local.find(in[i].vertex);
+                if (l == local.end() || l->second >= owned)
+                    continue;
+                if (in[i].distance < dist[l->second]) {
+                    dist[l->second] = in[i].distance;
+                    parent[l->second] = in[i].parent;
+                    pq.push(entry(in[i].distance, l->second));
+                }
+            }
+
+            while (!pq.empty()) {
+                entry top = pq.top();
+                pq.pop();
+                size_t v = top.second;
+                if (top.first > dist[v])
+                    continue;
+                for (size_t e = offsets[v]; e < offsets[v + 1]; ++e) {
+                    size_t t = targets[e];
+                    weight nd = dist[v] + (unit_weights ? weight(1)
+                                                        : weights[e]);
+                    if (!(nd < dist[t]))
+                        continue;
+                    dist[t] = nd;
+                    parent[t] = desc[v];
+                    if (t < owned)
+                        pq.push(entry(nd, t));
+                    else
+                        dirty[t - owned] = true;
+                }
+            }
+
+            out.clear();
+            for (size_t i = 0; i < dirty.size(); ++i) {
+                if (dirty[i]) {
+                    update u = {ghost_owner[i], desc[owned + i],
+                                parent[owned + i], dist[owned + i]};
+                    out.push_back(u);
+                    dirty[i] = false;
+                }
+            }
+            if (!sharded_send(fd, out))
+                return 1;
+        }
+
+        out.clear();
+        for (size_t i = 0; i < owned; ++i) {
+            if (dist[i] != infinity) {
+                update u = {s.id, desc[i], parent[i], dist[i]};
+                out.push_back(u);
+            }
+        }
+        if (!sharded_send(fd, out))
+            return 1;
+    } while (sharded_read(fd, &unit_weights, sizeof(unit_weights)));
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// The worker processes for sharded searches over the k shards written under
+/// prefix, one per shard. Graph names the graph type the shards were written
+/// from. The workers are forked by the constructor and kept for every
+/// search; each reads its shard when the first search starts, so the shards
+/// may be written afterwards. They exit when this is destroyed.
+///
+/// fork() copies only the calling thread, so a child can inherit a mutex,
+/// malloc's among them, that another thread held and will never release.
+/// Construct this before the process starts any threads, including those
+/// of scheduler::global().
+////////////////////////////////////////////////////////////////////////////////
+template<typename Graph>
+class sharded_workers {
+
+  typedef typename Graph::edge_property weight;
+  typedef sharded_update<weight> update;
+
+  public:
+
+    sharded_workers(const std::string& prefix, size_t k) : ok(true) {
+        // buffered output would otherwise be flushed once per process
+        std::cout.flush();
+        std::cerr.flush();
+
+        for (size_t s = 0; s < k; ++s) {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                ok = false;
+                break;
+            }
+            pid_t pid = fork();
+            if (pid == 0) {
+                for (size_t i = 0; i < fds.size(); ++i)
+                    close(fds[i]);
+                close(pair[0]);
+                _exit(sharded_worker<typename Graph::vertex_property, weight>(
+                    pair[1], shard_file_name(prefix, s)));
+            }
+            close(pair[1]);
+            if (pid < 0) {
+                close(pair[0]);
+                ok = false;
+                break;
+            }
+            fds.push_back(pair[0]);
+            pids.push_back(pid);
+        }
+    }
+
+    ~sharded_workers() {
+        for (size_t s = 0; s < fds.size(); ++s)
+            close(fds[s]);
+        for (size_t s = 0; s < pids.size(); ++s)
+            waitpid(pids[s], nullptr, 0);
+    }
+
+    sharded_workers(const sharded_workers&) = delete;
+    sharded_workers& operator=(const sharded_workers&) = delete;
+
+    /// Shortest paths from source; see sharded_sssp(). A failed search
+    /// leaves the workers out of step, so every later one fails too.
+    template<typename ParentMap, typename DistanceMap>
+    bool search(typename Graph::vertex_descriptor source, ParentMap& p,
+                DistanceMap& d, bool unit_weights) {
+        uint64_t unit = unit_weights;
+        for (size_t s = 0; s < fds.size() && ok; ++s)
+            ok = sharded_write(fds[s], &unit, sizeof(unit));
+
+        // the first round offers the source to everyone; only its owner
+        // keeps it
+        std::vector<std::vector<update> > inbox(fds.size());
+        update start = {0, source, source, weight(0)};
+        for (size_t s = 0; s < inbox.size(); ++s)
+            inbox[s].push_back(start);
+
+        std::vector<update> reply;
+        bool finish = false;
+        while (ok) {
+            for (size_t s = 0; s < fds.size() && ok; ++s) {
+                ok = sharded_send(fds[s], inbox[s]);
+                inbox[s].clear();
+            }
+
+            size_t routed = 0;
+            for (size_t s = 0; s < fds.size() && ok; ++s) {
+                ok = sharded_receive(fds[s], reply, finish) && !finish;
+                for (size_t i = 0; ok && i < reply.size(); ++i) {
+                    if (reply[i].shard >= inbox.size()) {
+                        ok = false;
+                        break;
+                    }
+                    inbox[reply[i].shard].push_back(reply[i]);
+                    ++routed;
+                }
+            }
+
+            if (routed == 0)
+                break;
+        }
+
+        uint64_t f = sharded_finish;
+        for (size_t s = 0; s < fds.size() && ok; ++s)
+            ok = sharded_write(fds[s], &f, sizeof(f));
+        for (size_t s = 0; s < fds.size() && ok; ++s) {
+            ok = sharded_receive(fds[s], reply, finish);
+            for (size_t i = 0; ok && i < reply.size(); ++i) {
+                d[reply[i].vertex] = reply[i].distance;
+                if (reply[i].vertex != source)
+                    p[reply[i].vertex] = reply[i].parent;
+            }
+        }
+        return ok;
+    }
+
+  private:
+
+    std::vector<int> fds;               ///< Coordinator end of each socket.
+    std::vector<pid_t> pids;            ///< Worker of each shard.
+    bool ok;                            ///< Every worker is in step.
+};
+
+// Shortest paths from source over the shards of workers. Fills p with the
+// shortest-path tree (the source has no entry) and d with the distances of
+// every reachable vertex. With unit_weights every edge counts 1, which makes
+// this a BFS. Returns false if a worker failed.
+template<typename Graph, typename ParentMap, typename DistanceMap>
+bool sharded_sssp(sharded_workers<Graph>& workers,
+                  typename Graph::vertex_descriptor source,
+                  ParentMap& p, DistanceMap& d, bool unit_weights = false) {
+    return workers.search(source, p, d, unit_weights);
+}
+
+// Multi-process BFS; see sharded_sssp().
+template<typename Graph, typename ParentMap, typename DistanceMap>
+bool sharded_bfs(sharded_workers<Graph>& workers,
+                 typename Graph::vertex_descriptor source,
+                 ParentMap& p, DistanceMap& d) {
+    return sharded_sssp(workers, source, p, d, true);
+}
+
+#endif
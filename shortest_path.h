@@ -0,0 +1,265 @@
+#ifndef _SHORTEST_PATH_H_
+#define _SHORTEST_PATH_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "connected_components.h"
+#include "csr_graph.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// Point-to-point shortest path queries over a CSR snapshot of a graph.
+///
+/// A query object builds the forward and reverse snapshots once and keeps its
+/// per-vertex search state between queries. Each array entry carries the
+/// number of the query that last wrote it, so starting a query only bumps the
+/// query number instead of clearing O(n) memory. Queries stop as soon as the
+/// answer is known rather than settling the whole graph. Edge weights must be
+/// non-negative.
+///
+/// One query object must not run two queries at once.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Graph>
+class shortest_path_query {
+
+  public:
+
+    typedef typename Graph::vertex_descriptor vertex_descriptor;
+    typedef typename Graph::edge_property weight;
+
+    explicit shortest_path_query(const Graph& g) :
+        fwd(g), bwd(fwd.transpose()), epoch(0), last_settled(0) {
+        state[0].resize(fwd.num_vertices());
+        state[1].resize(fwd.num_vertices());
+        connected_components(fwd, component);
+    }
+
+    /// Bidirectional Dijkstra from s to t. Searches forward from s and
+    /// backward from t, always advancing the side with the smaller frontier
+    /// key, and stops once the two keys together reach the best meeting
+    /// point found. Returns false if t is unreachable; otherwise sets dist
+    /// and fills path with the vertices from s to t.
+    bool bidirectional(vertex_descriptor s, vertex_descriptor t,
+                       weight& dist, std::vector<vertex_descriptor>& path) {
+        size_t src = fwd.index(s), dst = fwd.index(t);
+        path.clear();
+        last_settled = 0;
+        if (src == fwd.npos || dst == fwd.npos)
+            return false;
+        // no search needed between components
+        if (component[src] != component[dst])
+            return false;
+        begin_query();
+
+        heap q[2];
+        reach(0, src, weight(0), fwd.npos);
+        reach(1, dst, weight(0), fwd.npos);
+        q[0].push(entry(weight(0), src));
+        q[1].push(entry(weight(0), dst));
+
+        const csr_graph<Graph>* side[2] = {&fwd, &bwd};
+        bool found = src == dst;
+        weight best = weight(0);
+        size_t meet = src;
+
+        while (!q[0].empty() && !q[1].empty()) {
+            if (found && !(q[0].top().first + q[1].top().first < best))
+                break;
+
+            int dir = q[1].top().first < q[0].top().first ? 1 : 0;
+            entry top = q[dir].top();
+            q[dir].pop();
+            if (distance(dir, top.second) < top.first)
+                continue;
+            ++last_settled;
+
+            size_t v = top.second;
+            const csr_graph<Graph>& c = *side[dir];
+            const weight* w = c.weights_begin(v);
+            for (const size_t* u = c.neighbors_begin(v);
+                 u != c.neighbors_end(v); ++u, ++w) {
+                weight nd = top.first + *w;
+                if (!reached(dir, *u) || nd < distance(dir, *u)) {
+                    reach(dir, *u, nd, v);
+                    q[dir].push(entry(nd, *u));
+                }
+                // an edge into the other search closes an s-t path
+                if (reached(1 - dir, *u)) {
+                    weight through = distance(dir, *u) + distance(1 - dir, *u);
+                    if (!found || through < best) {
+                        found = true;
+                        best = through;
+                        meet = *u;
+                    }
+                }
+            }
+        }
+
+        if (!found)
+            return false;
+
+        dist = best;
+        for (size_t v = meet; v != fwd.npos; v = state[0][v].parent)
+            path.push_back(fwd.descriptor(v));
+        std::reverse(path.begin(), path.end());
+        for (size_t v = state[1][meet].parent; v != fwd.npos;
+             v = state[1][v].parent)
+            path.push_back(fwd.descriptor(v));
+        return true;
+    }
+
+    /// A* from s to t. h(vd) estimates the distance from vd to t and must be
+    /// consistent: it never drops by more than an edge's weight along that
+    /// edge and is 0 at t. The search then stops as soon as t is settled.
+    /// With h returning 0 this is Dijkstra with early exit. Returns false if
+    /// t is unreachable; otherwise sets dist and fills path with the vertices
+    /// from s to t.
+    template<typename Heuristic>
+    bool astar(vertex_descriptor s, vertex_descriptor t, Heuristic h,
+               weight& dist, std::vector<vertex_descriptor>& path) {
+        size_t src = fwd.index(s), dst = fwd.index(t);
+        path.clear();
+        last_settled = 0;
+        if (src == fwd.npos || dst == fwd.npos)
+            return false;
+        // no search needed between components
+        if (component[src] != component[dst])
+            return false;
+        begin_query();
+
+        // keys are distance + estimate; the true distance lives in state
+        heap q;
+        reach(0, src, weight(0), fwd.npos);
+        q.push(entry(h(s), src));
+
+        while (!q.empty()) {
+            entry top = q.top();
+            q.pop();
+            size_t v = top.second;
+            if (state[0][v].settled == epoch)
+                continue;
+            state[0][v].settled = epoch;
+            ++last_settled;
+            if (v == dst)
+                break;
+
+            const weight* w = fwd.weights_begin(v);
+            for (const size_t* u = fwd.neighbors_begin(v);
+                 u != fwd.neighbors_end(v); ++u, ++w) {
+                weight nd = distance(0, v) + *w;
+                if (!reached(0, *u) || nd < distance(0, *u)) {
+                    reach(0, *u, nd, v);
+                    q.push(entry(nd + h(fwd.descriptor(*u)), *u));
+                }
+            }
+        }
+
+        if (!reached(0, dst))
+            return false;
+
+        dist = distance(0, dst);
+        for (size_t v = dst; v != fwd.npos; v = state[0][v].parent)
+            path.push_back(fwd.descriptor(v));
+        std::reverse(path.begin(), path.end());
+        return true;
+    }
+
+    /// Number of vertices the last query settled.
+    size_t settled() const {return last_settled;}
+
+  private:
+
+    typedef std::pair<weight, size_t> entry;
+    typedef std::priority_queue<entry, std::vector<entry>,
+                                std::greater<entry> > heap;
+
+    // Search state of one vertex in one direction. An entry whose stamp is
+    // not the current epoch belongs to an older query and reads as unreached.
+    struct label {
+        weight dist = weight(0);
+        size_t parent = 0;
+        uint32_t stamp = 0;
+        uint32_t settled = 0;
+    };
+
+    void begin_query() {
+        if (++epoch == 0) {
+            // the counter wrapped; old stamps could look current again
+            for (int dir = 0; dir < 2; ++dir)
+                std::fill(state[dir].begin(), state[dir].end(), label());
+            epoch = 1;
+        }
+    }
+
+    bool reached(int dir, size_t v) const {
+        return state[dir][v].stamp == epoch;
+    }
+
+    weight distance(int dir, size_t v) const {
+        return reached(dir, v) ? state[dir][v].dist :
+                                 std::numeric_limits<weight>::max();
+    }
+
+    void reach(int dir, size_t v, weight d, size_t parent) {
+        label& l = state[dir][v];
+        if (l.stamp != epoch)
+            l.settled = 0;
+        l.dist = d;
+        l.parent = parent;
+        l.stamp = epoch;
+    }
+
+    csr_graph<Graph> fwd;          // out-edges
+    csr_graph<Graph> bwd;          // in-edges, for the backward search
+    std::vector<label> state[2];   // forward and backward search state
+    std::vector<size_t> component; // weakly connected component per vertex
+    uint32_t epoch;
+    size_t last_settled;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// A* heuristic for grid graphs such as initialize_mesh_graph builds, where
+/// vertex i sits at column i % width and row i / width. Estimates the
+/// Manhattan distance to the target times the smallest edge weight, which
+/// never overestimates.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Weight>
+class grid_heuristic {
+
+  public:
+
+    grid_heuristic(size_t width, size_t target, Weight min_weight) :
+        w(width), tx(target % width), ty(target / width), scale(min_weight) {}
+
+    Weight operator()(size_t v) const {
+        size_t x = v % w, y = v / w;
+        size_t steps = (x > tx ? x - tx : tx - x) + (y > ty ? y - ty : ty - y);
+        return Weight(steps) * scale;
+    }
+
+  private:
+
+    size_t w, tx, ty;
+    Weight scale;
+};
+
+// One-off bidirectional Dijkstra query from s to t. Repeated queries on the
+// same graph should keep a shortest_path_query instead, which builds its
+// snapshots once.
+template<typename Graph>
+bool shortest_path(const Graph& g, typename Graph::vertex_descriptor s,
+                   typename Graph::vertex_descriptor t,
+                   typename Graph::edge_property& dist,
+                   std::vector<typename Graph::vertex_descriptor>& path) {
+    shortest_path_query<Graph> q(g);
+    return q.bidirectional(s, t, dist, path);
+}
+
+#endif
@@ -1,14 +1,87 @@
+#include <atomic>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <future>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "compressed_graph.h"
+#include "connected_components.h"
+#include "contraction_hierarchy.h"
+#include "external_graph.h"
 #include "graph.h"
 #include "graph_algorithms.h"
+#include "graph_analytics.h"
+#include "graph_reorder.h"
+#include "graph_view.h"
+#include "query_server.h"
+#include "result_cache.h"
+#include "scheduler.h"
+#include "sharded_sssp.h"
+#include "shortest_path.h"
 #include "timer.h"
+#include "triangle_count.h"
 
 using namespace std;
 
+// Just enough of graph's read interface for compressed_graph: vertices
+// 0..n-1, with out-lists only where they are set. Lets the compressed test
+// span more than 2^24 vertices without paying for a graph that large.
+struct sparse_lists {
+    struct edge {
+        size_t s, t;
+        size_t source() const {return s;}
+        size_t target() const {return t;}
+    };
+    typedef vector<pair<size_t, const edge*> > adjacency;
+    typedef pair<size_t, const adjacency*> entry;
+
+    struct iterator {
+        const sparse_lists* g;
+        size_t v;
+        mutable entry current;
+
+        const entry* operator->() const {
+            auto i = g->lists.find(v);
+            current = entry(v, i == g->lists.end() ? &g->none : &i->second);
+            return &current;
+        }
+        iterator& operator++() {++v; return *this;}
+        bool operator!=(const iterator& o) const {return v != o.v;}
+    };
+
+    size_t n;
+    map<size_t, adjacency> lists;
+    deque<edge> edges;              // push_back keeps the pointers valid
+    adjacency none;
+
+    // neighbors of v, sorted
+    void set(size_t v, const vector<size_t>& neighbors) {
+        for (size_t u : neighbors) {
+            edges.push_back(edge{v, u});
+            lists[v].push_back(make_pair(u, &edges.back()));
+        }
+    }
+
+    size_t num_vertices() const {return n;}
+    iterator vertices_cbegin() const {return iterator{this, 0, entry()};}
+    iterator vertices_cend() const {return iterator{this, n, entry()};}
+};
+
 int main() {
+    // the sharded searches below fork their workers here, before anything
+    // starts a thread; see sharded_sssp.h
+    sharded_workers<graph<int, double> > football_workers("football", 4);
+    sharded_workers<graph<int, double> > mesh_workers("mesh", 3);
+
     timer t;
     t.start();
 
@@ -60,7 +133,6 @@ int main() {
 
 
     map<size_t, size_t> p;
-    graph<int, double>::vertex_descriptor vd(1);
 
     cout << "Starting BFS" << endl;
     breadth_first_search(g, p);
@@ -106,15 +178,11 @@ int main() {
    multimap<size_t,size_t> m;
    mst_kruskals(g,m);
    cout << "Finished Kruskal's for football.g.\n";
-   if(g.num_vertices()-1 == m.size()) {
+   // every game weighs the same, so any spanning forest is minimum; it has
+   // one edge fewer than vertices in each of the 21 components
+   if(g.num_vertices()-21 == m.size()) {
 	cout<< "Proper number of edges have been added to the MST.\n";
    }
-   else if(m.size() == 0)
-   {
-	cout << "All edges have the same weight. ";
-	cout << "Therefore, every spanning tree is a minimum spanning tree.\n\n";
-	success = false;
-   }
    else {
 	cout<< "Incorrect number of edges.\n\n";
 	success = false;
@@ -127,12 +195,12 @@ int main() {
 
    cout << "Running Kruskal's. Using input from test.g.\n";
    multimap<size_t,size_t> m2;
-   mst_kruskals(k,m);
+   mst_kruskals(k,m2);
    cout << "Finished Kruskal's for test.g.\n";
-   if(k.num_vertices()-1 == m.size()) {
+   if(k.num_vertices()-1 == m2.size()) {
 	cout<< "Proper number of edges have been added to the MST.\n";
    }
-   else if(m.size() == k.num_edges())
+   else if(m2.size() == k.num_edges())
    {
 	cout << "All edges have the same weight. ";
 	cout << "Therefore, every spanning tree is a minimum spanning tree.\n\n";
@@ -144,4 +212,954 @@ int main() {
    if(success) {
 	cout << "Kruskal's ran successfully.\n\n";
    }
+
+    cout << "Running multi-source BFS from every vertex of football.g.\n";
+    vector<graph<int, double>::vertex_descriptor> sources;
+    for (auto v = g.vertices_begin(); v != g.vertices_end(); ++v)
+        sources.push_back(v->first);
+
+    vector<map<size_t, size_t> > ms_p;
+    vector<map<size_t, size_t> > ms_d;
+    multi_source_bfs(g, sources, ms_p, ms_d);
+
+    // compare against one BFS per source, measuring depth along its tree
+    success = true;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        for (auto v = g.vertices_begin(); v != g.vertices_end(); ++v)
+            v->second->set_label(UNEXPLORED);
+        map<size_t, size_t> bfs_p;
+        BFS(g, sources[i], bfs_p);
+
+        if (ms_d[i].size() != bfs_p.size() + 1)
+            success = false;
+        for (auto v = bfs_p.begin(); v != bfs_p.end(); ++v) {
+            size_t depth = 0;
+            for (size_t u = v->first; u != sources[i]; u = bfs_p[u])
+                ++depth;
+            if (ms_d[i].count(v->first) == 0 || ms_d[i][v->first] != depth)
+                success = false;
+            // any parent one level closer to the source is a valid BFS tree
+            else if (ms_d[i][ms_p[i][v->first]] + 1 != depth)
+                success = false;
+        }
+    }
+
+    if (success) {
+        cout << "Multi-source BFS matched BFS for all sources.\n\n";
+    } else {
+        cout << "Multi-source BFS disagreed with BFS.\n\n";
+    }
+
+    cout << "Relabeling football.g in reverse Cuthill-McKee order.\n";
+    vector<size_t> order = compute_vertex_order(g, RCM_ORDER);
+    graph<int, double> r;
+    map<size_t, size_t> old_to_new;
+    // a reused graph: its descriptors no longer start at 0, and it must be
+    // empty to take the relabeled copy
+    r.erase_vertex(r.insert_vertex(0));
+    success = relabel_graph(g, order, r, old_to_new) &&
+              !relabel_graph(g, order, r, old_to_new);
+
+    success = success && order.size() == g.num_vertices() &&
+              old_to_new.size() == g.num_vertices() &&
+              r.num_vertices() == g.num_vertices() &&
+              r.num_edges() == g.num_edges();
+    for (auto e = g.edges_begin(); e != g.edges_end(); ++e) {
+        auto re = r.find_edge(make_pair(old_to_new[e->first.first],
+                                        old_to_new[e->first.second]));
+        if (re == r.edges_end() ||
+            re->second->property() != e->second->property())
+            success = false;
+    }
+
+    // BFS on the relabeled graph, translated back, must be a tree in g
+    map<size_t, size_t> rp, translated;
+    breadth_first_search(r, rp);
+    translate_parent_map(old_to_new, rp, translated);
+    if (translated.size() != rp.size())
+        success = false;
+    for (auto v = translated.begin(); v != translated.end(); ++v) {
+        if (g.find_edge(make_pair(v->second, v->first)) == g.edges_end())
+            success = false;
+    }
+
+    if (success) {
+        cout << "Relabeled graph matched football.g.\n\n";
+    } else {
+        cout << "Relabeled graph differed from football.g.\n\n";
+    }
+
+    cout << "Partitioning football.g into 4 shards.\n";
+    map<size_t, size_t> part;
+    size_t cut = partition_graph(g, 4, part);
+    cout << "Edge cut: " << cut << " of " << g.num_edges() << " edges.\n";
+    success = write_shards(g, part, 4, "football");
+
+    cout << "Running sharded BFS over 4 worker processes.\n";
+    map<size_t, size_t> sp;
+    map<size_t, double> sd;
+    success = success && sharded_bfs(football_workers, 0, sp, sd);
+    success = success && sd.size() == ms_d[0].size();
+    for (auto v = ms_d[0].begin(); success && v != ms_d[0].end(); ++v)
+        success = sd.count(v->first) && sd[v->first] == v->second;
+    for (size_t s = 0; s < 4; ++s)
+        remove(shard_file_name("football", s).c_str());
+
+    if (success) {
+        cout << "Sharded BFS matched BFS.\n\n";
+    } else {
+        cout << "Sharded BFS failed.\n\n";
+    }
+
+    cout << "Running sharded SSSP on a weighted 20x20 mesh over 3 workers.\n";
+    graph<int, double> mesh;
+    for (size_t i = 0; i < 400; ++i)
+        mesh.insert_vertex(i);
+    for (size_t i = 0; i < 400; ++i) {
+        if ((i + 1) % 20 != 0)
+            mesh.insert_edge_undirected(i, i + 1, (i * 7919) % 13 + 1);
+        if (i + 20 < 400)
+            mesh.insert_edge_undirected(i, i + 20, (i * 104729) % 17 + 1);
+    }
+    map<size_t, size_t> mesh_part;
+    partition_graph(mesh, 3, mesh_part);
+    success = write_shards(mesh, mesh_part, 3, "mesh");
+
+    map<size_t, size_t> mp;
+    map<size_t, double> md;
+    success = success && sharded_sssp(mesh_workers, 0, mp, md);
+    for (size_t s = 0; s < 3; ++s)
+        remove(shard_file_name("mesh", s).c_str());
+
+    // distances are shortest iff no edge can improve them and every vertex
+    // is reached through its tree parent
+    success = success && md.size() == 400 && md[0] == 0;
+    for (auto e = mesh.edges_begin(); success && e != mesh.edges_end(); ++e)
+        success = md[e->first.second] <= md[e->first.first] +
+                                         e->second->property();
+    for (auto v = mp.begin(); success && v != mp.end(); ++v) {
+        auto e = mesh.find_edge(make_pair(v->second, v->first));
+        success = e != mesh.edges_end() &&
+                  md[v->first] == md[v->second] + e->second->property();
+    }
+
+    // the workers stay for another search, now with every edge weighing 1
+    map<size_t, size_t> mesh_bp;
+    map<size_t, double> mesh_bd;
+    success = success && sharded_bfs(mesh_workers, 0, mesh_bp, mesh_bd) &&
+              mesh_bd.size() == 400;
+    for (size_t i = 0; success && i < 400; ++i)
+        success = mesh_bd[i] == i / 20 + i % 20;
+
+    if (success) {
+        cout << "Sharded SSSP distances are shortest paths.\n\n";
+    } else {
+        cout << "Sharded SSSP failed.\n\n";
+    }
+
+    cout << "Compressing football.g.\n";
+    compressed_graph cg(g);
+    csr_graph<graph<int, double> > csr(g);
+    success = cg.num_vertices() == csr.num_vertices() &&
+              cg.num_edges() == csr.num_edges();
+    for (size_t v = 0; success && v < csr.num_vertices(); ++v) {
+        vector<size_t> decoded;
+        cg.for_each_neighbor(v, [&decoded](size_t u) {decoded.push_back(u);});
+        success = equal(decoded.begin(), decoded.end(), csr.neighbors_begin(v)) &&
+                  decoded.size() == csr.degree(v);
+    }
+    cout << "Compressed adjacency: " << double(cg.adjacency_bytes()) / cg.num_edges()
+         << " bytes per edge.\n";
+
+    vector<size_t> cp, cd, cc, cc_football;
+    breadth_first_search(cg, cg.index(0), cp, cd);
+    for (size_t v = 0; success && v < cg.num_vertices(); ++v)
+        success = ms_d[0].count(cg.descriptor(v)) ?
+                  cd[v] == ms_d[0][cg.descriptor(v)] :
+                  cd[v] == compressed_graph::npos;
+    // 20 of football.g's teams play no games, so besides the 99 teams joined
+    // by their games there are 20 isolated vertices: 21 components
+    success = success && connected_components(cg, cc) == 21;
+    cc_football = cc;
+    for (auto e = g.edges_begin(); success && e != g.edges_end(); ++e)
+        success = cc[cg.index(e->first.first)] == cc[cg.index(e->first.second)];
+
+    // gaps needing 1 and 2 bytes, in lists long enough for whole groups
+    graph<int, double> sparse;
+    for (size_t i = 0; i < 70000; ++i)
+        sparse.insert_vertex(i);
+    vector<size_t> far = {1, 2, 300, 301, 5000, 69999, 70000 - 2};
+    sort(far.begin(), far.end());
+    for (size_t i = 0; i < far.size(); ++i)
+        sparse.insert_edge(0, far[i], 1);
+    sparse.insert_edge(69999, 5, 1);
+    compressed_graph cs(sparse);
+    vector<uint32_t> out(cs.max_degree());
+    success = success && cs.neighbors(0, out.data()) == far.size() &&
+              equal(far.begin(), far.end(), out.begin()) &&
+              cs.neighbors(69999, out.data()) == 1 && out[0] == 5 &&
+              connected_components(cs, cc) == 70000 - far.size() - 1;
+
+    // gaps needing 3 and 4 bytes, both in a whole group, decoded with SSSE3
+    // where the CPU has it, and in a short list, decoded by the scalar loop
+    sparse_lists huge;
+    huge.n = (1 << 24) + (1 << 17);
+    vector<size_t> group = {1, 2, 2 + (1 << 16), (1 << 24) + (1 << 16) + 5};
+    vector<size_t> tail = {(1 << 24) + 1, (1 << 24) + 1 + (1 << 16)};
+    huge.set(0, group);
+    huge.set(1, tail);
+    compressed_graph cw(huge);
+    vector<size_t> decoded;
+    cw.for_each_neighbor(0, [&decoded](size_t u) {decoded.push_back(u);});
+    success = success && cw.num_vertices() == huge.n &&
+              cw.num_edges() == group.size() + tail.size() &&
+              cw.neighbors(0, out.data()) == group.size() &&
+              equal(group.begin(), group.end(), out.begin()) &&
+              cw.neighbors(1, out.data()) == tail.size() &&
+              equal(tail.begin(), tail.end(), out.begin()) && decoded == group;
+
+    if (success) {
+        cout << "Compressed graph matched football.g.\n\n";
+    } else {
+        cout << "Compressed graph differed from football.g.\n\n";
+    }
+
+    cout << "Running point-to-point queries on the weighted 20x20 mesh.\n";
+    shortest_path_query<graph<int, double> > spq(mesh);
+    success = true;
+    for (size_t q = 0; q < 50; ++q) {
+        size_t s = (q * 7919) % 400, t = (q * 104729 + 13) % 400;
+        map<size_t, size_t> dp;
+        map<size_t, double> dd;
+        sssp_dijkstras(mesh, s, dp, dd);
+
+        double bd = -1, ad = -1;
+        vector<size_t> bpath, apath;
+        success = success && spq.bidirectional(s, t, bd, bpath) &&
+                  spq.astar(s, t, grid_heuristic<double>(20, t, 1.0), ad, apath) &&
+                  bd == dd[t] && ad == dd[t];
+
+        // both paths must run from s to t along edges summing to the distance
+        vector<size_t>* paths[] = {&bpath, &apath};
+        for (size_t i = 0; success && i < 2; ++i) {
+            vector<size_t>& path = *paths[i];
+            double sum = 0;
+            success = path.front() == s && path.back() == t;
+            for (size_t j = 0; success && j + 1 < path.size(); ++j) {
+                auto e = mesh.find_edge(make_pair(path[j], path[j + 1]));
+                success = e != mesh.edges_end();
+                if (success)
+                    sum += e->second->property();
+            }
+            success = success && sum == dd[t];
+        }
+    }
+
+    if (success) {
+        cout << "Bidirectional Dijkstra and A* matched Dijkstra's.\n\n";
+    } else {
+        cout << "Point-to-point queries disagreed with Dijkstra's.\n\n";
+    }
+
+    cout << "Building a contraction hierarchy for the weighted 20x20 mesh.\n";
+    contraction_hierarchy<graph<int, double> > ch(mesh);
+    stringstream saved;
+    contraction_hierarchy<graph<int, double> > loaded;
+    success = ch.save(saved) && loaded.load(saved) &&
+              loaded.num_edges() == ch.num_edges();
+    cout << "Added " << ch.num_shortcuts() << " shortcuts.\n";
+
+    for (size_t q = 0; success && q < 50; ++q) {
+        size_t s = (q * 7919) % 400, t = (q * 104729 + 13) % 400;
+        map<size_t, size_t> dp;
+        map<size_t, double> dd;
+        sssp_dijkstras(mesh, s, dp, dd);
+
+        double cd = -1, ld = -1;
+        vector<size_t> path, loaded_path;
+        success = ch.query(s, t, cd, path) && cd == dd[t] &&
+                  loaded.query(s, t, ld, loaded_path) && ld == cd &&
+                  loaded_path == path &&
+                  path.front() == s && path.back() == t;
+
+        // the unpacked path must use original edges only
+        double sum = 0;
+        for (size_t j = 0; success && j + 1 < path.size(); ++j) {
+            auto e = mesh.find_edge(make_pair(path[j], path[j + 1]));
+            success = e != mesh.edges_end();
+            if (success)
+                sum += e->second->property();
+        }
+        success = success && sum == dd[t];
+    }
+
+    // corrupt copies must be turned down without throwing: a count past the
+    // end of the stream, a truncated stream, decreasing offsets and an edge
+    // to a vertex out of range; a stream that cannot seek is read in chunks
+    const string image = saved.str();
+    const size_t n_at = 8, fwd_offsets_at = 16 + 8 * 400 + 8;
+    auto rejects = [&image](size_t at, uint64_t value, size_t keep) {
+        string bad = image.substr(0, keep);
+        if (at + sizeof(value) <= bad.size())
+            bad.replace(at, sizeof(value),
+                        reinterpret_cast<const char*>(&value), sizeof(value));
+        stringstream is(bad);
+        contraction_hierarchy<graph<int, double> > c;
+        return !c.load(is) && c.num_vertices() == 0;
+    };
+    struct unseekable : stringbuf {
+        explicit unseekable(const string& s) : stringbuf(s) {}
+        pos_type seekoff(off_type, ios_base::seekdir, ios_base::openmode) {
+            return pos_type(off_type(-1));
+        }
+    };
+    unseekable whole(image), huge_n(image.substr(0, n_at) +
+                                    string("\0\0\0\0\0\0\0\x40", 8) +
+                                    image.substr(n_at + 8));
+    istream whole_is(&whole), huge_n_is(&huge_n);
+    contraction_hierarchy<graph<int, double> > streamed, refused;
+
+    // and so are shortcuts that could not be unpacked: one through its own
+    // source or target, and upward edges that lead around a cycle
+    {
+        auto word = [&image](size_t at) {
+            uint64_t w;
+            memcpy(&w, image.data() + at, sizeof(w));
+            return size_t(w);
+        };
+        const size_t fwd_m = word(16 + 8 * 400);
+        const size_t to_at = fwd_offsets_at + 8 * 401;
+        const size_t middle_at = to_at + 16 * fwd_m;
+        size_t shortcut = 0;
+        while (shortcut < fwd_m && word(middle_at + 8 * shortcut) == size_t(-1))
+            ++shortcut;
+        size_t from = 0;
+        while (word(fwd_offsets_at + 8 * (from + 1)) <= shortcut)
+            ++from;
+        // an edge up from the shortcut's target, turned back to its source
+        size_t to = word(to_at + 8 * shortcut);
+        size_t up = word(fwd_offsets_at + 8 * to);
+        success = success && shortcut < fwd_m &&
+                  up < word(fwd_offsets_at + 8 * (to + 1)) &&
+                  rejects(middle_at + 8 * shortcut, from, image.size()) &&
+                  rejects(middle_at + 8 * shortcut, to, image.size()) &&
+                  rejects(to_at + 8 * up, from, image.size());
+    }
+
+    success = success && rejects(n_at, uint64_t(1) << 62, image.size()) &&
+              rejects(0, 0, image.size() / 2) &&
+              rejects(fwd_offsets_at + 8, uint64_t(1) << 40, image.size()) &&
+              rejects(fwd_offsets_at + 8 * 401, 400, image.size()) &&
+              !rejects(image.size(), 0, image.size()) &&
+              streamed.load(whole_is) &&
+              streamed.num_edges() == ch.num_edges() &&
+              !refused.load(huge_n_is);
+
+    if (success) {
+        cout << "Contraction hierarchy queries matched Dijkstra's.\n\n";
+    } else {
+        cout << "Contraction hierarchy queries disagreed with Dijkstra's.\n\n";
+    }
+
+    cout << "Running parallel connected components on football.g.\n";
+    vector<size_t> serial_cc, parallel_cc;
+    connected_components(csr, serial_cc, 1);
+    success = connected_components(csr, parallel_cc, 4) == 21 &&
+              serial_cc == parallel_cc && parallel_cc == cc_football;
+
+    // two weighted triangles: Kruskal's must stop at a two-tree forest
+    graph<int, double> forest;
+    for (size_t i = 0; i < 6; ++i)
+        forest.insert_vertex(i);
+    forest.insert_edge_undirected(0, 1, 1);
+    forest.insert_edge_undirected(1, 2, 2);
+    forest.insert_edge_undirected(0, 2, 3);
+    forest.insert_edge_undirected(3, 4, 4);
+    forest.insert_edge_undirected(4, 5, 5);
+    forest.insert_edge_undirected(3, 5, 6);
+    csr_graph<graph<int, double> > forest_csr(forest);
+    vector<size_t> forest_cc;
+    multimap<size_t, size_t> mst;
+    mst_kruskals(forest, mst);
+    double mst_weight = 0;
+    for (auto i = mst.begin(); i != mst.end(); ++i)
+        mst_weight += forest.find_edge(make_pair(i->second, i->first))
+                            ->second->property();
+    success = success && connected_components(forest_csr, forest_cc) == 2 &&
+              mst.size() == 4 && mst_weight == 12;
+
+    // with every weight equal, any spanning forest is minimum, but it must
+    // still span: the forest's edges alone leave the same two components
+    graph<int, double> flat, flat_forest;
+    for (size_t i = 0; i < 6; ++i) {
+        flat.insert_vertex(i);
+        flat_forest.insert_vertex(i);
+    }
+    for (auto e = forest.edges_begin(); e != forest.edges_end(); ++e)
+        flat.insert_edge(e->first.first, e->first.second, 1);
+    multimap<size_t, size_t> flat_mst;
+    mst_kruskals(flat, flat_mst);
+    for (auto i = flat_mst.begin(); i != flat_mst.end(); ++i)
+        flat_forest.insert_edge(i->second, i->first, 1);
+    csr_graph<graph<int, double> > flat_csr(flat_forest);
+    success = success && flat_mst.size() == 4 &&
+              connected_components(flat_csr, forest_cc) == 2;
+
+    // and a query between the triangles is rejected without searching
+    shortest_path_query<graph<int, double> > forest_q(forest);
+    double forest_d;
+    vector<size_t> forest_path;
+    success = success && !forest_q.bidirectional(0, 4, forest_d, forest_path) &&
+              forest_q.settled() == 0;
+
+    if (success) {
+        cout << "Connected components matched and Kruskal's built a forest.\n\n";
+    } else {
+        cout << "Connected components or Kruskal's failed.\n\n";
+    }
+
+    cout << "Counting triangles on football.g.\n";
+    // brute force over the undirected, simple neighbor sets
+    csr_graph<graph<int, double> > csr_t = csr.transpose();
+    vector<set<size_t> > adj(csr.num_vertices());
+    for (size_t v = 0; v < csr.num_vertices(); ++v) {
+        for (const size_t* u = csr.neighbors_begin(v);
+             u != csr.neighbors_end(v); ++u)
+            if (*u != v)
+                adj[v].insert(*u);
+        for (const size_t* u = csr_t.neighbors_begin(v);
+             u != csr_t.neighbors_end(v); ++u)
+            if (*u != v)
+                adj[v].insert(*u);
+    }
+    uint64_t brute = 0;
+    vector<uint64_t> brute_tri(csr.num_vertices(), 0);
+    for (size_t v = 0; v < adj.size(); ++v)
+        for (auto u = adj[v].begin(); u != adj[v].end(); ++u)
+            for (auto w = adj[*u].begin(); w != adj[*u].end(); ++w)
+                if (v < *u && *u < *w && adj[v].count(*w)) {
+                    ++brute;
+                    ++brute_tri[v];
+                    ++brute_tri[*u];
+                    ++brute_tri[*w];
+                }
+
+    vector<uint64_t> tri;
+    success = count_triangles(csr, tri, 4) == brute && tri == brute_tri &&
+              count_triangles(csr, 1) == brute && brute > 0;
+
+    // every vertex of a complete graph closes all its pairs
+    graph<int, double> complete;
+    for (size_t i = 0; i < 40; ++i)
+        complete.insert_vertex(i);
+    for (size_t i = 0; i < 40; ++i)
+        for (size_t j = i + 1; j < 40; ++j)
+            complete.insert_edge(i, j, 1);
+    csr_graph<graph<int, double> > complete_csr(complete);
+    vector<double> clustering;
+    success = success && count_triangles(complete_csr) == 9880 &&
+              clustering_coefficients(complete_csr, clustering) == 1.0 &&
+              clustering_coefficients(forest_csr, clustering) == 1.0;
+
+    if (success) {
+        cout << "Found " << brute << " triangles; clustering matched.\n\n";
+    } else {
+        cout << "Triangle counts or clustering coefficients were wrong.\n\n";
+    }
+
+    cout << "Running PageRank and label propagation on football.g.\n";
+    // plain power iteration as the reference
+    const size_t fn = csr.num_vertices();
+    vector<double> ref(fn, 1.0 / fn), ref_next(fn);
+    for (size_t it = 0; it < 200; ++it) {
+        double dangling = 0;
+        fill(ref_next.begin(), ref_next.end(), 0.0);
+        for (size_t v = 0; v < fn; ++v) {
+            if (csr.degree(v) == 0)
+                dangling += ref[v];
+            for (const size_t* u = csr.neighbors_begin(v);
+                 u != csr.neighbors_end(v); ++u)
+                ref_next[*u] += 0.85 * ref[v] / csr.degree(v);
+        }
+        for (size_t v = 0; v < fn; ++v)
+            ref_next[v] += (0.15 + 0.85 * dangling) / fn;
+        ref.swap(ref_next);
+    }
+
+    vector<double> pr, pr_serial;
+    vector<float> pr_float;
+    pull_engine<double> engine(csr, 4, 64);
+    success = pagerank(engine, pr, 0.85, 1e-12, 200) < 200 &&
+              pagerank(csr, pr_serial, 0.85, 1e-12, 200, 1) < 200 &&
+              pagerank(csr, pr_float) > 0;
+    double pr_sum = 0;
+    for (size_t v = 0; success && v < fn; ++v) {
+        success = fabs(pr[v] - ref[v]) < 1e-9 &&
+                  fabs(pr_serial[v] - ref[v]) < 1e-9 &&
+                  fabs(pr_float[v] - ref[v]) < 1e-4;
+        pr_sum += pr[v];
+    }
+    success = success && fabs(pr_sum - 1) < 1e-9;
+
+    // personalized ranks stay on what the source reaches
+    vector<size_t> reach_d, reach_p;
+    multi_source_bfs_dense(csr, vector<size_t>(1, 0), reach_d, reach_p);
+    vector<double> ppr;
+    personalized_pagerank(engine, vector<size_t>(1, 0), ppr);
+    for (size_t v = 0; success && v < fn; ++v)
+        success = (ppr[v] > 0) == (reach_d[v] != csr.npos);
+
+    // each triangle of the forest settles on one label
+    vector<size_t> communities;
+    label_propagation(forest_csr, communities);
+    success = success && communities[0] == communities[1] &&
+              communities[1] == communities[2] &&
+              communities[3] == communities[4] &&
+              communities[4] == communities[5] &&
+              communities[0] != communities[3];
+
+    if (success) {
+        cout << "PageRank matched power iteration; communities found.\n\n";
+    } else {
+        cout << "PageRank or label propagation failed.\n\n";
+    }
+
+    cout << "Running the work-stealing scheduler on 4 threads.\n";
+    scheduler pool(4);
+    vector<atomic<size_t> > hits(100000);
+    for (size_t i = 0; i < hits.size(); ++i)
+        hits[i] = 0;
+    pool.parallel_for(0, hits.size(), 7, [&hits](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+            ++hits[i];
+    });
+    success = pool.num_threads() == 4;
+    for (size_t i = 0; success && i < hits.size(); ++i)
+        success = hits[i] == 1;
+
+    // a reduction, with nested loops inside, under a cap of two threads
+    atomic<size_t> running(0), most(0);
+    size_t sum = pool.parallel_reduce(0, 1000, 1, size_t(0),
+        [&](size_t b, size_t e) {
+            size_t now = ++running;
+            for (size_t seen = most; now > seen &&
+                 !most.compare_exchange_weak(seen, now);) {}
+            size_t inner = pool.parallel_reduce(0, 100, 10, size_t(0),
+                [](size_t ib, size_t ie) {return ie - ib;},
+                [](size_t x, size_t y) {return x + y;});
+            --running;
+            return (e - b) * inner;
+        },
+        [](size_t x, size_t y) {return x + y;}, 2);
+    success = success && sum == 100000 && most <= 2;
+
+    if (success) {
+        cout << "Every range ran once and the reduction matched.\n\n";
+    } else {
+        cout << "The scheduler lost or repeated work.\n\n";
+    }
+
+    cout << "Running the batched query server on football.g and the mesh.\n";
+    query_server<graph<int, double> > football_server(g, 4, 8);
+    const csr_graph<graph<int, double> >& fs = football_server.snapshot();
+
+    // a paused server queues up to its limit and refuses the rest
+    football_server.pause();
+    vector<future<vector<size_t> > > hop_answers(6);
+    vector<future<bool> > reach_answers(2);
+    success = true;
+    for (size_t i = 0; i < 6; ++i)
+        success = success && football_server.bfs(fs.descriptor(i * 19),
+                                                 hop_answers[i]);
+    success = success &&
+              football_server.reachable(fs.descriptor(0), fs.descriptor(1),
+                                        reach_answers[0]) &&
+              football_server.reachable(fs.descriptor(0), fs.descriptor(0),
+                                        reach_answers[1]);
+    future<bool> refused_answer;
+    success = success &&
+              !football_server.reachable(0, 1, refused_answer) &&
+              football_server.rejected() == 1;
+
+    thread waiting;
+    {
+        string socket_path = "query_server_test.sock";
+        query_socket_server<graph<int, double> > socket_server(
+            football_server, socket_path);
+        query_socket_client<double> client(socket_path);
+        bool reached = false;
+        success = success && socket_server.ok() && client.ok() &&
+                  !client.reachable(0, 1, reached) && client.busy();
+
+        // once resumed, every queued query comes out of one round
+        football_server.resume();
+        vector<size_t> bp, bd;
+        for (size_t i = 0; success && i < 6; ++i) {
+            vector<size_t> hops = hop_answers[i].get();
+            breadth_first_search(cg, cg.index(fs.descriptor(i * 19)), bp, bd);
+            for (size_t v = 0; success && v < fs.num_vertices(); ++v)
+                success = hops[v] == bd[cg.index(fs.descriptor(v))];
+        }
+        breadth_first_search(cg, cg.index(fs.descriptor(0)), bp, bd);
+        success = success &&
+                  reach_answers[0].get() ==
+                      (bd[cg.index(fs.descriptor(1))] != cg.npos) &&
+                  reach_answers[1].get() && football_server.batches() == 1;
+
+        // and the socket answers match the in-process ones
+        vector<query_entry<uint64_t> > socket_hops;
+        breadth_first_search(cg, cg.index(fs.descriptor(3)), bp, bd);
+        success = success && client.bfs(fs.descriptor(3), socket_hops);
+        size_t reachable_count = 0;
+        for (size_t v = 0; v < bd.size(); ++v)
+            reachable_count += bd[v] != cg.npos;
+        success = success && socket_hops.size() == reachable_count;
+        for (size_t i = 0; success && i < socket_hops.size(); ++i)
+            success = bd[cg.index(socket_hops[i].vertex)] ==
+                      socket_hops[i].value;
+
+        // connections that hang up are closed, and their threads reaped
+        for (size_t i = 0; success && i < 3; ++i) {
+            query_socket_client<double> brief(socket_path);
+            success = brief.ok() && brief.reachable(fs.descriptor(0),
+                                                    fs.descriptor(0), reached) &&
+                      reached;
+        }
+        for (size_t i = 0; success && i < 100000 &&
+                           socket_server.open_connections() != 1; ++i)
+            this_thread::yield();
+        success = success && socket_server.open_connections() == 1;
+
+        // a connection left waiting on a paused server must not keep the
+        // destructor from returning
+        football_server.pause();
+        atomic<bool> sent(false);
+        waiting = thread([&socket_path, &fs, &sent]() {
+            query_socket_client<double> late(socket_path);
+            vector<query_entry<uint64_t> > late_hops;
+            sent = true;
+            late.bfs(fs.descriptor(5), late_hops);
+        });
+        while (!sent)
+            this_thread::yield();
+        this_thread::sleep_for(chrono::milliseconds(20));
+    }
+    waiting.join();
+
+    query_server<graph<int, double> > mesh_server(mesh, 2);
+    for (size_t s = 0; success && s < 400; s += 57) {
+        future<vector<double> > answer;
+        map<size_t, size_t> dp;
+        map<size_t, double> dd;
+        sssp_dijkstras(mesh, s, dp, dd);
+        success = mesh_server.sssp(s, answer);
+        vector<double> dist = answer.get();
+        const csr_graph<graph<int, double> >& ms = mesh_server.snapshot();
+        for (size_t v = 0; success && v < dist.size(); ++v)
+            success = dist[v] == dd[ms.descriptor(v)];
+    }
+    success = success && mesh_server.latency(SSSP_QUERY).count() == 8;
+
+    if (success) {
+        cout << "Query server answers matched BFS and Dijkstra's.\n\n";
+    } else {
+        cout << "Query server answers were wrong.\n\n";
+    }
+
+    cout << "Caching BFS and Kruskal's results on a 10x10 mesh.\n";
+    graph<int, double> grid;
+    for (int i = 0; i < 100; ++i)
+        grid.insert_vertex(i);
+    for (size_t i = 0; i < 100; ++i) {
+        if (i % 10 != 9)
+            grid.insert_edge_undirected(i, i + 1, double((i * 31) % 7 + 1));
+        if (i < 90)
+            grid.insert_edge_undirected(i, i + 10, double((i * 17) % 5 + 1));
+    }
+
+    // a second lookup on an unchanged graph returns the same result
+    result_cache<graph<int, double>, map<size_t, size_t> > bfs_cache(grid);
+    shared_ptr<const map<size_t, size_t> > first =
+        cached_bfs(grid, bfs_cache, 0);
+    shared_ptr<const map<size_t, size_t> > again =
+        cached_bfs(grid, bfs_cache, 0);
+    map<size_t, size_t> direct;
+    for (auto v = grid.vertices_begin(); v != grid.vertices_end(); ++v)
+        v->second->set_label(UNEXPLORED);
+    BFS(grid, 0, direct);
+    success = first == again && *first == direct &&
+              bfs_cache.hit_count() == 1 && bfs_cache.miss_count() == 1 &&
+              bfs_cache.hit_rate() == 0.5;
+
+    // every kind of mutation moves the epoch on and invalidates the entry
+    size_t epoch = grid.epoch();
+    grid.insert_edge(0, 99, 1.0);
+    success = success && grid.epoch() != epoch;
+    shared_ptr<const map<size_t, size_t> > shortcut =
+        cached_bfs(grid, bfs_cache, 0);
+    success = success && shortcut != first && shortcut->at(99) == 0 &&
+              bfs_cache.invalidations() == 1;
+    epoch = grid.epoch();
+    grid.erase_edge(make_pair(size_t(0), size_t(99)));
+    success = success && grid.epoch() != epoch &&
+              *cached_bfs(grid, bfs_cache, 0) == direct;
+    epoch = grid.epoch();
+    size_t extra = grid.insert_vertex(100);
+    success = success && grid.epoch() != epoch;
+    epoch = grid.epoch();
+    grid.erase_vertex(extra);
+    success = success && grid.epoch() != epoch &&
+              bfs_cache.invalidations() == 2;
+
+    // with room for two results, a third evicts the least recently used
+    result_cache<graph<int, double>, map<size_t, size_t> > small_cache(
+        grid, 2 * bfs_cache.bytes() + bfs_cache.bytes() / 2);
+    cached_bfs(grid, small_cache, 0);
+    cached_bfs(grid, small_cache, 1);
+    cached_bfs(grid, small_cache, 0);
+    cached_bfs(grid, small_cache, 2);
+    success = success && small_cache.size() == 2 &&
+              small_cache.evictions() == 1 &&
+              small_cache.bytes() <= small_cache.budget();
+    cached_bfs(grid, small_cache, 0);
+    cached_bfs(grid, small_cache, 1);
+    success = success && small_cache.hit_count() == 2 &&
+              small_cache.miss_count() == 4;
+
+    result_cache<graph<int, double>, multimap<size_t, size_t> > mst_cache(
+        grid);
+    shared_ptr<const multimap<size_t, size_t> > mst_first =
+        cached_mst_kruskals(grid, mst_cache);
+    success = success && mst_first->size() == 99 &&
+              cached_mst_kruskals(grid, mst_cache) == mst_first;
+    grid.erase_edge(make_pair(size_t(0), size_t(1)));
+    grid.erase_edge(make_pair(size_t(1), size_t(0)));
+    success = success && cached_mst_kruskals(grid, mst_cache) != mst_first &&
+              mst_cache.hit_count() == 1;
+
+    if (success) {
+        cout << "Cached results were reused and invalidated correctly.\n\n";
+    } else {
+        cout << "Cached results were wrong.\n\n";
+    }
+
+    // the Makefile builds this file once more with GRAPH_MEMORY_ACCOUNTING
+    // defined, so the tests run on both layouts of graph
+#ifdef GRAPH_MEMORY_ACCOUNTING
+    cout << "Accounting for the memory of a 10-vertex graph.\n";
+    graph<int, double> small;
+    for (int i = 0; i < 10; ++i)
+        small.insert_vertex(i);
+    for (size_t i = 0; i < 10; ++i) {
+        small.insert_edge(i, (i + 1) % 10, 1.0);
+        small.insert_edge(i, (i + 3) % 10, 2.0);
+    }
+    memory_report used = small.memory_usage();
+    typedef pair<const pair<size_t, size_t>, void*> adjacent;
+    success = used.properties == 10 * sizeof(int) + 20 * sizeof(double) &&
+              used.adjacency > 40 * sizeof(adjacent) &&
+              used.index > 30 * sizeof(adjacent) && used.slack > 0 &&
+              used.peak == used.total() && used.allocators > 0 &&
+              used.allocators < used.adjacency;
+
+    // erasing gives everything back but leaves the peak where it was
+    small.clear();
+    memory_report freed = small.memory_usage();
+    success = success && freed.total() == 0 && freed.peak == used.peak;
+
+    if (success) {
+        cout << "Memory usage was accounted for by category.\n\n";
+    } else {
+        cout << "Memory usage was accounted for wrongly.\n\n";
+    }
+#endif
+
+    cout << "Running semi-external BFS and components on football.g.\n";
+    string edge_path = "external_test.edges";
+    success = write_edge_file(csr, edge_path);
+    {
+        // eight edges per block, so runs and scans cross block boundaries
+        edge_file ef(edge_path, 8 * sizeof(edge_record));
+        vector<uint64_t> runs;
+        success = success && ef.ok() && ef.num_edges() == csr.num_edges() &&
+                  ef.index(runs);
+
+        vector<size_t> all(csr.num_vertices()), ms_d, ms_p;
+        for (size_t v = 0; v < all.size(); ++v)
+            all[v] = v;
+        multi_source_bfs_dense(csr, all, ms_d, ms_p);
+        vector<size_t> depth, parent;
+        const size_t n = csr.num_vertices();
+        for (size_t s = 0; success && s < n; ++s) {
+            success = external_bfs(ef, runs, s, depth, parent);
+            for (size_t v = 0; success && v < n; ++v) {
+                success = depth[v] == ms_d[s * n + v];
+                if (success && v != s && depth[v] != csr.npos)
+                    success = depth[parent[v]] + 1 == depth[v] &&
+                              count(csr.neighbors_begin(parent[v]),
+                                    csr.neighbors_end(parent[v]), v) != 0;
+            }
+        }
+
+        vector<size_t> external_cc;
+        size_t external_components = 0;
+        success = success &&
+                  external_connected_components(ef, external_cc,
+                                                external_components) &&
+                  external_components == 21 && external_cc == cc_football;
+    }
+
+    // a file written out of order fails, and a bad file does not open
+    {
+        edge_file_writer unsorted(edge_path, 4);
+        success = success && unsorted.append(2, 3) &&
+                  !unsorted.append(1, 0) && !unsorted.close();
+    }
+    success = success && !edge_file(edge_path).ok() &&
+              !edge_file("missing.edges").ok();
+
+    // nor does one whose header counts are out of range, even when the
+    // edge count would overflow into a matching file size
+    {
+        edge_file_writer tiny(edge_path, 4);
+        success = success && tiny.append(0, 1) && tiny.append(1, 2) &&
+                  tiny.close();
+    }
+    auto patch = [&edge_path](size_t at, uint64_t value) {
+        fstream io(edge_path, ios::in | ios::out | ios::binary);
+        io.seekp(at);
+        io.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    success = success && edge_file(edge_path).ok();
+    patch(offsetof(edge_file_header, edges), 2 + (uint64_t(1) << 61));
+    success = success && !edge_file(edge_path).ok();
+    patch(offsetof(edge_file_header, edges), 2);
+    patch(offsetof(edge_file_header, vertices), (uint64_t(1) << 32) + 1);
+    success = success && !edge_file(edge_path).ok();
+    remove(edge_path.c_str());
+
+    if (success) {
+        cout << "Semi-external BFS and components matched in memory.\n\n";
+    } else {
+        cout << "Semi-external BFS or components disagreed.\n\n";
+    }
+
+    cout << "Cloning, moving and viewing football.g.\n";
+    graph<int, double> copy = g.clone();
+    success = copy.num_vertices() == g.num_vertices() &&
+              copy.num_edges() == g.num_edges();
+    for (auto v = g.vertices_cbegin(); success && v != g.vertices_cend(); ++v) {
+        auto cv = copy.find_vertex(v->first);
+        success = cv != copy.vertices_cend() &&
+                  cv->second->property() == v->second->property();
+        // the same adjacency, pointing at the copy's own edges
+        auto a = v->second->cbegin();
+        auto b = success ? cv->second->cbegin() : a;
+        for (; success && a != v->second->cend(); ++a, ++b)
+            success = b != cv->second->cend() && a->first == b->first &&
+                      a->second != b->second;
+        success = success && b == cv->second->cend();
+    }
+    for (auto e = g.edges_cbegin(); success && e != g.edges_cend(); ++e) {
+        auto ce = copy.find_edge(e->first);
+        success = ce != copy.edges_cend() && ce->second != e->second &&
+                  ce->second->property() == e->second->property();
+    }
+    success = success &&
+              copy.insert_vertex(0) == prev(g.vertices_cend())->first + 1;
+
+    // moving takes the contents and leaves a usable empty graph behind
+    size_t copy_vertices = copy.num_vertices();
+    size_t copy_epoch = copy.epoch();
+    graph<int, double> moved(std::move(copy));
+    success = success && moved.num_vertices() == copy_vertices &&
+              copy.num_vertices() == 0 && moved.epoch() != copy_epoch;
+#ifdef GRAPH_MEMORY_ACCOUNTING
+    success = success && copy.memory_usage().total() == 0;
+#endif
+    copy.insert_edge(copy.insert_vertex(1), copy.insert_vertex(2), 1.0);
+    moved = std::move(copy);
+    success = success && moved.num_vertices() == 2 && moved.num_edges() == 1 &&
+              copy.num_vertices() == 0;
+
+    // copying a graph onto itself leaves it alone
+    moved.copy_from(moved);
+    success = success && moved.num_vertices() == 2 && moved.num_edges() == 1;
+
+    // a view's counts follow the graph and its filter as they change
+    set<size_t> kept = {0, 1};
+    auto kept_view = induced_subgraph(moved, kept);
+    success = success && kept_view.num_vertices() == 2 &&
+              kept_view.num_edges() == 1;
+    moved.insert_edge(moved.insert_vertex(3), 0, 1.0);
+    kept.erase(1);
+    success = success && kept_view.num_vertices() == 1 &&
+              kept_view.num_edges() == 0;
+    kept.insert(2);
+    success = success && kept_view.num_vertices() == 2 &&
+              kept_view.num_edges() == 1;
+
+    // copying a view of a graph onto that graph keeps only what it shows
+    moved.copy_from(kept_view);
+    success = success && moved.num_vertices() == 2 &&
+              moved.num_edges() == 1 &&
+              moved.find_vertex(1) == moved.vertices_end() &&
+              moved.edges_cbegin()->first == make_pair(size_t(2), size_t(0));
+
+    // the even vertices of football.g, as a view and built by hand
+    set<size_t> even;
+    graph<int, double> even_graph;
+    for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v)
+        if (v->first % 2 == 0) {
+            even.insert(v->first);
+            even_graph.insert_vertex(v->second->property());
+        }
+    for (auto e = g.edges_cbegin(); e != g.edges_cend(); ++e)
+        if (e->first.first % 2 == 0 && e->first.second % 2 == 0)
+            even_graph.insert_edge(e->first.first / 2, e->first.second / 2,
+                                   e->second->property());
+    auto even_view = induced_subgraph(g, even);
+    csr_graph<decltype(even_view)> even_csr(even_view);
+    csr_graph<graph<int, double> > built_csr(even_graph);
+    success = success && even_view.num_vertices() == even.size() &&
+              even_view.num_edges() == even_graph.num_edges() &&
+              even_csr.num_edges() == built_csr.num_edges();
+    for (size_t v = 0; success && v < even_csr.num_vertices(); ++v)
+        success = even_csr.descriptor(v) == 2 * built_csr.descriptor(v) &&
+                  equal(even_csr.neighbors_begin(v), even_csr.neighbors_end(v),
+                        built_csr.neighbors_begin(v));
+
+    // the light edges of the mesh: Dijkstra's on the view, on a clone of it
+    // and on a graph without the heavy edges must agree
+    auto light = edge_filtered_view(mesh,
+        [](const pair<size_t, size_t>&, double w) {return w <= 10;});
+    graph<int, double> light_copy = light.clone();
+    graph<int, double> light_graph;
+    for (int i = 0; i < 400; ++i)
+        light_graph.insert_vertex(i);
+    for (auto e = mesh.edges_cbegin(); e != mesh.edges_cend(); ++e)
+        if (e->second->property() <= 10)
+            light_graph.insert_edge(e->first.first, e->first.second,
+                                    e->second->property());
+    success = success && light.num_edges() == light_graph.num_edges() &&
+              light_copy.num_edges() == light_graph.num_edges() &&
+              light.num_edges() < mesh.num_edges();
+    for (size_t s = 0; success && s < 400; s += 79) {
+        map<size_t, size_t> vp, cp, gp;
+        map<size_t, double> vd, cd, gd;
+        sssp_dijkstras(light, s, vp, vd);
+        sssp_dijkstras(light_copy, s, cp, cd);
+        sssp_dijkstras(light_graph, s, gp, gd);
+        success = vd == gd && cd == gd;
+    }
+    multimap<size_t, size_t> light_mst, graph_mst;
+    mst_kruskals(light, light_mst);
+    mst_kruskals(light_graph, graph_mst);
+    success = success && light_mst == graph_mst;
+
+    if (success) {
+        cout << "Clones, moves and views matched the graphs they came from.\n\n";
+    } else {
+        cout << "Clones, moves or views were wrong.\n\n";
+    }
 }
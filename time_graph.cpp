@@ -1,16 +1,36 @@
 #include <climits>
 #include <cmath>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 #include <fstream>
 
+// graph<>::memory_usage() is reported below
+#define GRAPH_MEMORY_ACCOUNTING
+
+#include "compressed_graph.h"
+#include "connected_components.h"
+#include "contraction_hierarchy.h"
+#include "external_graph.h"
 #include "graph.h"
 #include "graph_algorithms.h"
+#include "graph_analytics.h"
+#include "graph_reorder.h"
+#include "graph_view.h"
+#include "query_server.h"
+#include "result_cache.h"
+#include "scheduler.h"
+#include "shortest_path.h"
 #include "timer.h"
+#include "triangle_count.h"
 
 
 using namespace std;
@@ -75,6 +95,50 @@ void initialize_random_graph(graph<int, double>& g, size_t n) {
     }
 }
 
+// PageRank written directly against the graph's maps, as a baseline for the
+// pull engine. Runs a fixed number of iterations.
+void pagerank_maps(const graph<int, double>& g, map<size_t, double>& rank,
+                   size_t iterations) {
+    const double n = g.num_vertices();
+    for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v)
+        rank[v->first] = 1 / n;
+
+    for (size_t it = 0; it < iterations; ++it) {
+        map<size_t, double> next;
+        double dangling = 0;
+        for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v) {
+            size_t degree = 0;
+            for (auto e = v->second->cbegin(); e != v->second->cend(); ++e)
+                if (e->second->source() == v->first)
+                    ++degree;
+            if (degree == 0)
+                dangling += rank[v->first];
+            for (auto e = v->second->cbegin(); e != v->second->cend(); ++e)
+                if (e->second->source() == v->first)
+                    next[e->second->target()] +=
+                        0.85 * rank[v->first] / degree;
+        }
+        for (auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v)
+            rank[v->first] = next[v->first] + (0.15 + 0.85 * dangling) / n;
+    }
+}
+
+// Report the bytes g holds, per edge and by category, and its peak. The
+// bytes per edge leave out the allocators the accounting adds, so they are
+// those of the default layout.
+void report_memory(const graph<int, double>& g, ostream& out) {
+    memory_report m = g.memory_usage();
+    out << "\tMemory: " << m.total() / 1024 << " KB, ";
+    if(g.num_edges() != 0)
+        out << double(m.total() - m.allocators) / g.num_edges()
+            << " bytes/edge without accounting ";
+    out << "(properties " << m.properties / 1024 << " KB, index "
+        << m.index / 1024 << " KB, adjacency " << m.adjacency / 1024
+        << " KB, slack " << m.slack / 1024 << " KB, allocators "
+        << m.allocators / 1024 << " KB), peak " << m.peak / 1024 << " KB"
+        << endl;
+}
+
 // Run a timed test suite with one of the above initializers.
 template<typename Initializer>
 void time_graph(Initializer i, size_t n) {
@@ -89,6 +153,48 @@ void time_graph(Initializer i, size_t n) {
     t.stop();
     cout << "\tCreate: " << t.elapsed() / 1e6 << " ms" << endl;
     os << "\tCreate: " << t.elapsed() / 1e6 << " ms" << endl;
+    report_memory(g, cout);
+    report_memory(g, os);
+    t.restart();
+
+    // Test copying: vertex by vertex and edge by edge, then in bulk.
+
+    graph_id inserted;
+    for(auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v)
+        inserted.insert_vertex(v->second->property());
+    for(auto e = g.edges_cbegin(); e != g.edges_cend(); ++e)
+        inserted.insert_edge(e->first.first, e->first.second,
+                             e->second->property());
+
+    t.stop();
+    cout << "\tCopy by insertion: " << t.elapsed() / 1e6 << " ms" << endl;
+    os << "\tCopy by insertion: " << t.elapsed() / 1e6 << " ms" << endl;
+    inserted.clear();
+    t.restart();
+
+    graph_id cloned = g.clone();
+
+    t.stop();
+    cout << "\tClone: " << t.elapsed() / 1e6 << " ms" << endl;
+    os << "\tClone: " << t.elapsed() / 1e6 << " ms" << endl;
+    cloned.clear();
+    t.restart();
+
+    // Test the subgraph induced by the even vertices, as a view.
+
+    unordered_set<size_t> even;
+    for(auto v = g.vertices_cbegin(); v != g.vertices_cend(); ++v)
+        if(v->first % 2 == 0)
+            even.insert(v->first);
+    t.restart();
+    auto even_view = induced_subgraph(g, even);
+    csr_graph<decltype(even_view)> even_csr(even_view);
+
+    t.stop();
+    cout << "\tInduced subgraph snapshot: " << t.elapsed() / 1e6 << " ms, "
+         << even_csr.num_edges() << " edges" << endl;
+    os << "\tInduced subgraph snapshot: " << t.elapsed() / 1e6 << " ms, "
+       << even_csr.num_edges() << " edges" << endl;
     t.restart();
 
     // Test BFS.
@@ -102,6 +208,153 @@ void time_graph(Initializer i, size_t n) {
     os << "\tBFS: " << t.elapsed() / 1e6 << " ms" << endl;
     t.restart();
 
+    // Test BFS from 64 sources, one search per source versus one batched
+    // multi-source search.
+
+    vector<vertex_descriptor> sources;
+    for(size_t i = 0; i < 64; ++i)
+        sources.push_back(rand() % g.num_vertices());
+
+    for(size_t i = 0; i < sources.size(); ++i) {
+        for(auto v = g.vertices_begin(); v != g.vertices_end(); ++v)
+            v->second->set_label(UNEXPLORED);
+        parent_map.clear();
+        BFS(g, sources[i], parent_map);
+    }
+
+    t.stop();
+    cout << "\t64 x BFS: " << t.elapsed() / 1e6 << " ms" << endl;
+    os << "\t64 x BFS: " << t.elapsed() / 1e6 << " ms" << endl;
+    t.restart();
+
+    vector<unordered_map<vertex_descriptor, vertex_descriptor> > ms_parents;
+    vector<unordered_map<vertex_descriptor, size_t> > ms_distances;
+    multi_source_bfs(g, sources, ms_parents, ms_distances);
+
+    t.stop();
+    cout << "\tMulti-source BFS (64): " << t.elapsed() / 1e6 << " ms" << endl;
+    os << "\tMulti-source BFS (64): " << t.elapsed() / 1e6 << " ms" << endl;
+    t.restart();
+
+    csr_graph<graph_id> csr(g);
+    vector<size_t> dense_sources, dense_d, dense_p;
+    for(size_t i = 0; i < sources.size(); ++i)
+        dense_sources.push_back(csr.index(sources[i]));
+    multi_source_bfs_dense(csr, dense_sources, dense_d, dense_p);
+
+    t.stop();
+    cout << "\tMulti-source BFS (64, dense): " << t.elapsed() / 1e6 << " ms" << endl;
+    os << "\tMulti-source BFS (64, dense): " << t.elapsed() / 1e6 << " ms" << endl;
+    t.restart();
+
+    // Test BFS over the compressed adjacency.
+
+    compressed_graph cg(g);
+
+    t.stop();
+    cout << "\tCompress: " << t.elapsed() / 1e6 << " ms, "
+         << double(cg.adjacency_bytes()) / cg.num_edges() << " bytes/edge ("
+         << double(cg.memory_bytes()) / cg.num_edges() << " with index)" << endl;
+    os << "\tCompress: " << t.elapsed() / 1e6 << " ms, "
+       << double(cg.adjacency_bytes()) / cg.num_edges() << " bytes/edge ("
+       << double(cg.memory_bytes()) / cg.num_edges() << " with index)" << endl;
+    t.restart();
+
+    vector<size_t> compressed_p, compressed_d;
+    breadth_first_search(cg, 0, compressed_p, compressed_d);
+
+    t.stop();
+    cout << "\tCompressed BFS: " << t.elapsed() / 1e6 << " ms" << endl;
+    os << "\tCompressed BFS: " << t.elapsed() / 1e6 << " ms" << endl;
+    t.restart();
+
+    // Test connected components, serial and on every core.
+
+    vector<size_t> component;
+    size_t components = connected_components(csr, component, 1);
+
+    t.stop();
+    cout << "\tConnected components (1 thread): " << t.elapsed() / 1e6
+         << " ms, " << components << " components" << endl;
+    os << "\tConnected components (1 thread): " << t.elapsed() / 1e6
+       << " ms, " << components << " components" << endl;
+    t.restart();
+
+    connected_components(csr, component);
+
+    t.stop();
+    cout << "\tConnected components (all cores): " << t.elapsed() / 1e6
+         << " ms" << endl;
+    os << "\tConnected components (all cores): " << t.elapsed() / 1e6
+       << " ms" << endl;
+    t.restart();
+
+    // Test triangle counting and clustering coefficients.
+
+    uint64_t triangles = count_triangles(csr);
+
+    t.stop();
+    cout << "\tTriangles: " << t.elapsed() / 1e6 << " ms, " << triangles
+         << " triangles" << endl;
+    os << "\tTriangles: " << t.elapsed() / 1e6 << " ms, " << triangles
+       << " triangles" << endl;
+    t.restart();
+
+    vector<double> clustering;
+    double average_clustering = clustering_coefficients(csr, clustering);
+
+    t.stop();
+    cout << "\tClustering coefficients: " << t.elapsed() / 1e6 << " ms, "
+         << average_clustering << " average" << endl;
+    os << "\tClustering coefficients: " << t.elapsed() / 1e6 << " ms, "
+       << average_clustering << " average" << endl;
+    t.restart();
+
+    // Test PageRank, on the maps and with the pull engine, for a fixed 20
+    // iterations, and label propagation.
+
+    map<size_t, double> map_rank;
+    pagerank_maps(g, map_rank, 20);
+
+    t.stop();
+    cout << "\tPageRank (maps, 20 iterations): " << t.elapsed() / 1e6
+         << " ms" << endl;
+    os << "\tPageRank (maps, 20 iterations): " << t.elapsed() / 1e6
+       << " ms" << endl;
+    t.restart();
+
+    pull_engine<double> engine(csr);
+    vector<double> rank;
+    pagerank(engine, rank, 0.85, 0, 20);
+
+    t.stop();
+    cout << "\tPageRank (engine, double): " << t.elapsed() / 1e6 << " ms"
+         << endl;
+    os << "\tPageRank (engine, double): " << t.elapsed() / 1e6 << " ms"
+       << endl;
+    t.restart();
+
+    pull_engine<float> float_engine(csr);
+    vector<float> float_rank;
+    pagerank(float_engine, float_rank, 0.85, 0, 20);
+
+    t.stop();
+    cout << "\tPageRank (engine, float): " << t.elapsed() / 1e6 << " ms"
+         << endl;
+    os << "\tPageRank (engine, float): " << t.elapsed() / 1e6 << " ms"
+       << endl;
+    t.restart();
+
+    vector<size_t> communities;
+    size_t rounds = label_propagation(csr, communities);
+
+    t.stop();
+    cout << "\tLabel propagation: " << t.elapsed() / 1e6 << " ms, "
+         << rounds << " rounds" << endl;
+    os << "\tLabel propagation: " << t.elapsed() / 1e6 << " ms, "
+       << rounds << " rounds" << endl;
+    t.restart();
+
     // Test Kruskal's algorithm.
 
     parent_map.clear();
@@ -111,6 +364,36 @@ void time_graph(Initializer i, size_t n) {
     cout <<"\tKruskal's: " << t.elapsed() / 1e6 << " ms" << endl;
     os <<"\tKruskal's: " << t.elapsed() / 1e6 << " ms" << endl;
     t.restart();
+
+    // Test the result cache: the 64 BFS sources and Kruskal's once to fill
+    // it, then every query again from the cache.
+
+    typedef unordered_map<vertex_descriptor, vertex_descriptor> parents;
+    result_cache<graph_id, parents> cache(g, size_t(1) << 30);
+    for(size_t i = 0; i < sources.size(); ++i)
+        cached_bfs(g, cache, sources[i]);
+    cached_mst_kruskals(g, cache);
+
+    t.stop();
+    cout << "\tCache fill: " << t.elapsed() / 1e6 << " ms, "
+         << cache.bytes() / 1024 << " KB" << endl;
+    os << "\tCache fill: " << t.elapsed() / 1e6 << " ms, "
+       << cache.bytes() / 1024 << " KB" << endl;
+    t.restart();
+
+    size_t found = 0;
+    for(size_t i = 0; i < sources.size(); ++i)
+        found += cached_bfs(g, cache, sources[i])->size();
+    found += cached_mst_kruskals(g, cache)->size();
+
+    t.stop();
+    cout << "\tCache hits: " << t.elapsed() / 1e3 / (sources.size() + 1)
+         << " us per query, hit rate " << cache.hit_rate() << endl;
+    os << "\tCache hits: " << t.elapsed() / 1e3 / (sources.size() + 1)
+       << " us per query, hit rate " << cache.hit_rate() << endl;
+    if(found == 0)
+        cout << "\tCache returned empty results" << endl;
+    t.restart();
     // Test find operations.
 
     double sum = 0;
@@ -155,10 +438,178 @@ void time_graph(Initializer i, size_t n) {
     t.stop();
     cout << "\tErase: " << t.elapsed() / 1e6 << " ms" << endl;
     os << "\tErase: " << t.elapsed() / 1e6 << " ms" << endl;
+    report_memory(g, cout);
+    report_memory(g, os);
     t.restart();
 
   
 }
+// Time traversals of g before and after relabeling it in each vertex order.
+void time_reordering(graph<int, double>& g, string name) {
+    typedef graph<int, double> graph_id;
+    typedef graph_id::vertex_descriptor vertex_descriptor;
+
+    cout << "Testing vertex orders on " << name << " graph..." << endl;
+    os << "Testing vertex orders on " << name << " graph..." << endl;
+
+    const char* names[] = {"original", "degree", "BFS", "RCM"};
+    const VertexOrder kinds[] = {DEGREE_ORDER, BFS_ORDER, RCM_ORDER};
+
+    // the same 64 vertices under every order, by original descriptor
+    csr_graph<graph_id> original(g);
+    vector<vertex_descriptor> picked;
+    for(size_t i = 0; i < 64; ++i)
+        picked.push_back(original.descriptor(rand() % g.num_vertices()));
+
+    for(size_t k = 0; k < 4; ++k) {
+        timer t;
+        t.start();
+
+        graph_id relabeled;
+        graph_id* h = &g;
+        vector<vertex_descriptor> order;
+        unordered_map<vertex_descriptor, vertex_descriptor> old_to_new;
+        if(k != 0) {
+            order = compute_vertex_order(g, kinds[k - 1]);
+            relabel_graph(g, order, relabeled, old_to_new);
+            h = &relabeled;
+        }
+
+        t.stop();
+        double relabel = t.elapsed() / 1e6;
+        t.restart();
+
+        // time several full searches so small inputs register
+        for(size_t i = 0; i < 10; ++i) {
+            unordered_map<vertex_descriptor, vertex_descriptor> parent_map;
+            breadth_first_search(*h, parent_map);
+        }
+
+        t.stop();
+        double bfs = t.elapsed() / 1e6;
+        t.restart();
+
+        // search from the picked vertices wherever the order put them
+        csr_graph<graph_id> csr(*h);
+        vector<size_t> sources;
+        for(size_t i = 0; i < picked.size(); ++i)
+            sources.push_back(csr.index(k == 0 ? picked[i] :
+                                                 old_to_new[picked[i]]));
+        vector<size_t> dense_d, dense_p;
+        multi_source_bfs_dense(csr, sources, dense_d, dense_p);
+
+        t.stop();
+        double msbfs = t.elapsed() / 1e6;
+
+        cout << "\t" << names[k] << ": relabel " << relabel << " ms, 10 x BFS "
+             << bfs << " ms, multi-source BFS (64) " << msbfs << " ms" << endl;
+        os << "\t" << names[k] << ": relabel " << relabel << " ms, 10 x BFS "
+           << bfs << " ms, multi-source BFS (64) " << msbfs << " ms" << endl;
+    }
+    cout << endl;
+    os << endl;
+}
+
+// Time point-to-point queries on a mesh of size ~n: a full single-source
+// Dijkstra's per query against bidirectional Dijkstra and A*.
+void time_point_to_point(size_t n) {
+    typedef graph<int, double> graph_id;
+    typedef graph_id::vertex_descriptor vertex_descriptor;
+
+    cout << "Testing point-to-point queries on mesh graph..." << endl;
+    os << "Testing point-to-point queries on mesh graph..." << endl;
+
+    graph_id g;
+    initialize_mesh_graph(g, n);
+    size_t rootn = sqrt(g.num_vertices());
+
+    double min_weight = g.edges_begin()->second->property();
+    for(auto e = g.edges_begin(); e != g.edges_end(); ++e)
+        min_weight = min(min_weight, e->second->property());
+
+    const size_t queries = 100;
+    vector<pair<vertex_descriptor, vertex_descriptor> > pairs;
+    for(size_t i = 0; i < queries; ++i)
+        pairs.push_back(make_pair(rand() % g.num_vertices(),
+                                  rand() % g.num_vertices()));
+
+    timer t;
+    t.start();
+
+    for(size_t i = 0; i < queries; ++i) {
+        unordered_map<vertex_descriptor, vertex_descriptor> p;
+        unordered_map<vertex_descriptor, double> d;
+        sssp_dijkstras(g, pairs[i].first, p, d);
+    }
+
+    t.stop();
+    double full = t.elapsed() / 1e6 / queries;
+    t.restart();
+
+    shortest_path_query<graph_id> q(g);
+
+    t.stop();
+    double setup = t.elapsed() / 1e6;
+    t.restart();
+
+    size_t settled = 0;
+    double dist;
+    vector<vertex_descriptor> path;
+    for(size_t i = 0; i < queries; ++i) {
+        q.bidirectional(pairs[i].first, pairs[i].second, dist, path);
+        settled += q.settled();
+    }
+
+    t.stop();
+    double bidirectional = t.elapsed() / 1e6 / queries;
+    double bidirectional_settled = double(settled) / queries;
+    t.restart();
+
+    settled = 0;
+    for(size_t i = 0; i < queries; ++i) {
+        q.astar(pairs[i].first, pairs[i].second,
+                grid_heuristic<double>(rootn, pairs[i].second, min_weight),
+                dist, path);
+        settled += q.settled();
+    }
+
+    t.stop();
+    double astar = t.elapsed() / 1e6 / queries;
+    double astar_settled = double(settled) / queries;
+    t.restart();
+
+    contraction_hierarchy<graph_id> ch(g);
+
+    t.stop();
+    double preprocess = t.elapsed() / 1e6;
+    t.restart();
+
+    for(size_t i = 0; i < queries; ++i)
+        ch.query(pairs[i].first, pairs[i].second, dist, path);
+
+    t.stop();
+    double hierarchy = t.elapsed() / 1e6 / queries;
+
+    cout << "\tDijkstra's (full): " << full << " ms/query" << endl
+         << "\tQuery setup: " << setup << " ms" << endl
+         << "\tBidirectional: " << bidirectional << " ms/query, "
+         << bidirectional_settled << " settled" << endl
+         << "\tA*: " << astar << " ms/query, " << astar_settled << " settled"
+         << endl
+         << "\tContraction hierarchy: " << preprocess << " ms preprocessing, "
+         << ch.num_shortcuts() << " shortcuts, " << hierarchy << " ms/query"
+         << endl << endl;
+    os << "\tDijkstra's (full): " << full << " ms/query" << endl
+       << "\tQuery setup: " << setup << " ms" << endl
+       << "\tBidirectional: " << bidirectional << " ms/query, "
+       << bidirectional_settled << " settled" << endl
+       << "\tA*: " << astar << " ms/query, " << astar_settled << " settled"
+       << endl
+       << "\tContraction hierarchy: " << preprocess << " ms preprocessing, "
+       << ch.num_shortcuts() << " shortcuts, " << hierarchy << " ms/query"
+       << endl << endl;
+}
+
 /// @brief Control timing of a single function
 /// @tparam Func Function type
 /// @param f Function taking a single size_t parameter
@@ -185,12 +636,182 @@ void time_function(Func f, size_t graph_size, string name) {
 }
 
 
+// Time the parallel algorithms on the shared scheduler with 1, 2, 4, ...
+// threads up to every core, and report the speedup over one thread.
+void time_scaling(graph<int, double>& g, string name) {
+    cout << "Testing thread scaling on " << name << " graph..." << endl;
+    os << "Testing thread scaling on " << name << " graph..." << endl;
+
+    csr_graph<graph<int, double> > csr(g);
+    size_t cores = scheduler::global().num_threads();
+    double base = 0;
+    for (size_t threads = 1; ; threads = min(2 * threads, cores)) {
+        timer t;
+        t.start();
+
+        vector<size_t> component;
+        connected_components(csr, component, threads);
+        count_triangles(csr, threads);
+        pull_engine<double> engine(csr, threads);
+        vector<double> rank;
+        pagerank(engine, rank, 0.85, 0, 20);
+
+        t.stop();
+        if (threads == 1)
+            base = t.elapsed();
+        cout << "\t" << threads << " threads: " << t.elapsed() / 1e6
+             << " ms, speedup " << base / t.elapsed() << endl;
+        os << "\t" << threads << " threads: " << t.elapsed() / 1e6
+           << " ms, speedup " << base / t.elapsed() << endl;
+        if (threads == cores)
+            break;
+    }
+    cout << endl;
+    os << endl;
+}
+
+// Time BFS queries from concurrent clients: answered one at a time, as a
+// synchronous request loop would, and through the batched query server.
+void time_query_server(graph<int, double>& g, string name) {
+    cout << "Testing the query server on " << name << " graph..." << endl;
+    os << "Testing the query server on " << name << " graph..." << endl;
+
+    const size_t clients = 16, per_client = 32;
+    csr_graph<graph<int, double> > csr(g);
+    timer t;
+    t.start();
+
+    vector<size_t> d, p;
+    for (size_t i = 0; i < clients * per_client; ++i)
+        multi_source_bfs_dense(csr, vector<size_t>(1, i % csr.num_vertices()),
+                               d, p);
+
+    t.stop();
+    double serial = t.elapsed();
+    cout << "\tOne at a time: " << serial / 1e6 << " ms, "
+         << clients * per_client / (serial / 1e9) << " queries/s" << endl;
+    os << "\tOne at a time: " << serial / 1e6 << " ms, "
+       << clients * per_client / (serial / 1e9) << " queries/s" << endl;
+
+    query_server<graph<int, double> > server(g);
+    t.restart();
+
+    // each client waits for one answer before asking the next question
+    vector<thread> threads;
+    for (size_t c = 0; c < clients; ++c)
+        threads.emplace_back([&server, &csr, c, per_client]() {
+            for (size_t i = 0; i < per_client; ++i) {
+                future<vector<size_t> > hops;
+                size_t s = (c * per_client + i) % csr.num_vertices();
+                while (!server.bfs(csr.descriptor(s), hops))
+                    this_thread::yield();
+                hops.get();
+            }
+        });
+    for (size_t c = 0; c < clients; ++c)
+        threads[c].join();
+
+    t.stop();
+    const latency_histogram& h = server.latency(BFS_QUERY);
+    cout << "\tQuery server: " << t.elapsed() / 1e6 << " ms, "
+         << clients * per_client / (t.elapsed() / 1e9) << " queries/s, "
+         << double(server.batched()) / server.batches()
+         << " queries/batch, p50 " << h.percentile(0.5) << " us, p99 "
+         << h.percentile(0.99) << " us" << endl << endl;
+    os << "\tQuery server: " << t.elapsed() / 1e6 << " ms, "
+       << clients * per_client / (t.elapsed() / 1e9) << " queries/s, "
+       << double(server.batched()) / server.batches()
+       << " queries/batch, p50 " << h.percentile(0.5) << " us, p99 "
+       << h.percentile(0.99) << " us" << endl << endl;
+}
+
+// Time semi-external BFS and connected components over a generated edge file
+// of about edges random edges, eight per vertex.
+void time_external(size_t edges) {
+    cout << "Timing semi-external search over " << edges << " edges" << endl;
+    os << "Timing semi-external search over " << edges << " edges" << endl;
+
+    string path = "time_graph.edges";
+    size_t n = max<size_t>(edges / 8, 1);
+    if(n > uint32_t(-1)) {
+        cout << "\tToo many vertices for an edge file" << endl;
+        return;
+    }
+    timer t;
+    t.start();
+
+    edge_file_writer w(path, n);
+    uint64_t x = 88172645463325252ull;
+    for(size_t v = 0; v < n; ++v)
+        for(size_t i = 0; i < 8; ++i) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            w.append(v, x % n);
+        }
+    if(!w.close()) {
+        cout << "\tCould not write " << path << endl;
+        return;
+    }
+    double mb = double(n) * 8 * sizeof(edge_record) / (1 << 20);
+
+    t.stop();
+    cout << "\tWrite: " << t.elapsed() / 1e6 << " ms, " << mb << " MB" << endl;
+    os << "\tWrite: " << t.elapsed() / 1e6 << " ms, " << mb << " MB" << endl;
+    t.restart();
+
+    edge_file f(path);
+    vector<uint64_t> runs;
+    bool ok = f.ok() && f.index(runs);
+
+    t.stop();
+    cout << "\tIndex: " << t.elapsed() / 1e6 << " ms" << endl;
+    os << "\tIndex: " << t.elapsed() / 1e6 << " ms" << endl;
+    t.restart();
+
+    // BFS reads only the runs of each frontier, so rate what it read
+    vector<size_t> depth, parent;
+    size_t before = f.bytes_read();
+    ok = ok && external_bfs(f, runs, 0, depth, parent);
+    double read_mb = double(f.bytes_read() - before) / (1 << 20);
+    size_t levels = 0;
+    for(size_t v = 0; v < depth.size(); ++v)
+        if(depth[v] != edge_file::npos)
+            levels = max(levels, depth[v] + 1);
+
+    t.stop();
+    cout << "\tBFS: " << t.elapsed() / 1e6 << " ms, " << levels
+         << " levels, " << t.elapsed() / 1e6 / max<size_t>(levels, 1)
+         << " ms/level, " << read_mb << " MB read, "
+         << read_mb / (t.elapsed() / 1e9) << " MB/s" << endl;
+    os << "\tBFS: " << t.elapsed() / 1e6 << " ms, " << levels
+       << " levels, " << t.elapsed() / 1e6 / max<size_t>(levels, 1)
+       << " ms/level, " << read_mb << " MB read, "
+       << read_mb / (t.elapsed() / 1e9) << " MB/s" << endl;
+    t.restart();
+
+    vector<size_t> component;
+    size_t components = 0;
+    ok = ok && external_connected_components(f, component, components);
+
+    t.stop();
+    cout << "\tConnected components: " << t.elapsed() / 1e6 << " ms, "
+         << components << " components, "
+         << mb / (t.elapsed() / 1e9) << " MB/s" << endl;
+    os << "\tConnected components: " << t.elapsed() / 1e6 << " ms, "
+       << components << " components, "
+       << mb / (t.elapsed() / 1e9) << " MB/s" << endl << endl;
+    if(!ok)
+        cout << "\tReading " << path << " failed" << endl;
+    remove(path.c_str());
+}
+
 /// @brief Main function to time all your functions
 int main(int argc, char** argv) {
-    if(argc != 4) {
+    if(argc != 4 && argc != 5) {
         cerr << "Error. Wrong number of arguments. Run program like:" << endl
                  << "./timing.o <complete_graph_size> <mesh_graph_size> "
-                 << "<random_graph_size>" << endl
+                 << "<random_graph_size> [<external_edges>]" << endl
                  << "Example: ./timing.o 300 1750 800" << endl;
         exit(-1);
     }
@@ -200,8 +821,25 @@ int main(int argc, char** argv) {
     size_t complete_size = atoi(argv[1]);
     size_t     mesh_size = atoi(argv[2]);
     size_t   random_size = atoi(argv[3]);
+    size_t external_edges = argc == 5 ? strtoull(argv[4], nullptr, 10) :
+                                        size_t(1) << 22;
 
     time_function(initialize_complete_graph, complete_size, "complete");
     time_function(    initialize_mesh_graph,     mesh_size,     "mesh");
     time_function(  initialize_random_graph,   random_size,   "random");
+
+    graph<int, double> random;
+    initialize_random_graph(random, random_size);
+    time_reordering(random, "random");
+    time_scaling(random, "random");
+    time_query_server(random, "random");
+
+    graph<int, double> football;
+    ifstream is{"football.g"};
+    is >> football;
+    time_reordering(football, "football.g");
+
+    time_point_to_point(mesh_size);
+
+    time_external(external_edges);
 }
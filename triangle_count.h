@@ -0,0 +1,322 @@
+#ifndef _TRIANGLE_COUNT_H_
+#define _TRIANGLE_COUNT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "csr_graph.h"
+#include "scheduler.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define TRIANGLE_COUNT_X86 1
+#endif
+
+// Triangle counting and clustering coefficients.
+//
+// The graph is treated as undirected and simple: edge direction, parallel
+// edges and self-loops are ignored. Each vertex keeps only the neighbors that
+// rank above it, where vertices are ranked by degree and then by index. A
+// triangle u < v < w in that ranking is then found exactly once, as w in the
+// intersection of the lists of u and v, and no list is longer than
+// O(sqrt(m)). The lists are sorted 32-bit arrays. They are intersected four
+// values against four with SSE2 compares, or eight against eight with AVX2
+// when the CPU has it. Ranking by degree leaves high-degree vertices with
+// short lists, but a vertex still costs one intersection per list entry,
+// each as long as the neighbor's list, so costs vary from vertex to vertex;
+// vertices are shared out in small ranges by the work-stealing scheduler to
+// even that out.
+
+////////////////////////////////////////////////////////////////////////////////
+/// Degree-ordered adjacency: for each vertex, its sorted neighbors of higher
+/// rank, along with its undirected degree.
+////////////////////////////////////////////////////////////////////////////////
+struct oriented_adjacency {
+    std::vector<size_t> offsets;     // n + 1 offsets into targets
+    std::vector<uint32_t> targets;   // higher-ranked neighbors, ascending
+    std::vector<size_t> degree;      // undirected degree of each vertex
+
+    size_t num_vertices() const {return degree.size();}
+    const uint32_t* begin(size_t v) const {return targets.data() + offsets[v];}
+    size_t size(size_t v) const {return offsets[v + 1] - offsets[v];}
+};
+
+// Build the degree-ordered adjacency of a CSR snapshot.
+template<typename Graph>
+void orient_by_degree(const csr_graph<Graph>& c, oriented_adjacency& o) {
+    const size_t n = c.num_vertices();
+    csr_graph<Graph> t = c.transpose();
+
+    // merge out- and in-neighbors, which are both sorted, without duplicates
+    // or self-loops; run once to count and once to fill
+    auto merge = [&c, &t](size_t v, std::vector<uint32_t>* out) {
+        const size_t* a = c.neighbors_begin(v);
+        const size_t* a_end = c.neighbors_end(v);
+        const size_t* b = t.neighbors_begin(v);
+        const size_t* b_end = t.neighbors_end(v);
+        size_t count = 0, last = c.npos;
+        while (a != a_end || b != b_end) {
+            size_t u = b == b_end || (a != a_end && *a < *b) ? *a++ : *b++;
+            if (u == v || u == last)
+                continue;
+            last = u;
+            ++count;
+            if (out)
+                out->push_back(uint32_t(u));
+        }
+        return count;
+    };
+
+    o.degree.resize(n);
+    for (size_t v = 0; v < n; ++v)
+        o.degree[v] = merge(v, 0);
+
+    auto above = [&o](size_t u, size_t v) {
+        return o.degree[u] > o.degree[v] ||
+               (o.degree[u] == o.degree[v] && u > v);
+    };
+
+    o.offsets.assign(1, 0);
+    o.targets.clear();
+    std::vector<uint32_t> list;
+    for (size_t v = 0; v < n; ++v) {
+        list.clear();
+        merge(v, &list);
+        for (size_t i = 0; i < list.size(); ++i)
+            if (above(list[i], v))
+                o.targets.push_back(list[i]);
+        o.offsets.push_back(o.targets.size());
+    }
+}
+
+// Intersect two sorted arrays by merging. f(block, mask) is called for each
+// common value with block pointing at it in a and mask 1.
+template<typename F>
+void intersect_scalar(const uint32_t* a, size_t na,
+                      const uint32_t* b, size_t nb, F& f) {
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            ++i;
+        } else if (b[j] < a[i]) {
+            ++j;
+        } else {
+            f(a + i, 1u);
+            ++i;
+            ++j;
+        }
+    }
+}
+
+#ifdef TRIANGLE_COUNT_X86
+// SSE2 intersection: compare four values of a against all four rotations of
+// four values of b, then advance whichever block ends lower (or both). f gets
+// each block of a with a bitmask of its values found in b.
+template<typename F>
+void intersect_sse2(const uint32_t* a, size_t na,
+                    const uint32_t* b, size_t nb, F& f) {
+    while (na >= 4 && nb >= 4) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x39))),
+            _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x4E)),
+                _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, 0x93))));
+        unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(m));
+        if (mask != 0)
+            f(a, mask);
+
+        uint32_t amax = a[3], bmax = b[3];
+        // branch-free: the comparisons are hard to predict
+        size_t step_a = 4 * (amax <= bmax), step_b = 4 * (bmax <= amax);
+        a += step_a;
+        na -= step_a;
+        b += step_b;
+        nb -= step_b;
+    }
+    intersect_scalar(a, na, b, nb, f);
+}
+
+// AVX2 intersection: as intersect_sse2 with blocks of eight, using the eight
+// lane rotations of b.
+template<typename F>
+__attribute__((target("avx2")))
+void intersect_avx2(const uint32_t* a, size_t na,
+                    const uint32_t* b, size_t nb, F& f) {
+    // every rotation comes straight from vb, so the permutes run in parallel
+    __m256i rotate[8];
+    for (int r = 0; r < 8; ++r)
+        rotate[r] = _mm256_setr_epi32(r, (r + 1) & 7, (r + 2) & 7,
+                                      (r + 3) & 7, (r + 4) & 7, (r + 5) & 7,
+                                      (r + 6) & 7, (r + 7) & 7);
+    while (na >= 8 && nb >= 8) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        __m256i m = _mm256_cmpeq_epi32(va, vb);
+        for (int r = 1; r < 8; ++r)
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi32(va,
+                    _mm256_permutevar8x32_epi32(vb, rotate[r])));
+        unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(m));
+        if (mask != 0)
+            f(a, mask);
+
+        uint32_t amax = a[7], bmax = b[7];
+        // branch-free: the comparisons are hard to predict
+        size_t step_a = 8 * (amax <= bmax), step_b = 8 * (bmax <= amax);
+        a += step_a;
+        na -= step_a;
+        b += step_b;
+        nb -= step_b;
+    }
+    intersect_sse2(a, na, b, nb, f);
+}
+#endif
+
+// Intersect two sorted arrays with the widest kernel the CPU supports.
+template<typename F>
+void intersect_sorted(const uint32_t* a, size_t na,
+                      const uint32_t* b, size_t nb, F& f) {
+    // skip the leading values of either array that the other cannot match
+    if (na == 0 || nb == 0 || a[na - 1] < b[0] || b[nb - 1] < a[0])
+        return;
+    const uint32_t* a_begin = std::lower_bound(a, a + na, b[0]);
+    const uint32_t* b_begin = std::lower_bound(b, b + nb, a[0]);
+    na -= a_begin - a;
+    nb -= b_begin - b;
+    a = a_begin;
+    b = b_begin;
+#ifdef TRIANGLE_COUNT_X86
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+        intersect_avx2(a, na, b, nb, f);
+    else
+        intersect_sse2(a, na, b, nb, f);
+#else
+    intersect_scalar(a, na, b, nb, f);
+#endif
+}
+
+// Number of triangles in the graph, counted on threads threads (0 uses every
+// core).
+inline uint64_t count_triangles(const oriented_adjacency& o,
+                                size_t threads = 0) {
+    return parallel_reduce(0, o.num_vertices(), 64, uint64_t(0),
+        [&o](size_t begin, size_t end) {
+            // only the number of matches matters here
+            uint64_t found = 0;
+            auto count = [&found](const uint32_t*, unsigned mask) {
+                found += __builtin_popcount(mask);
+            };
+            for (size_t u = begin; u < end; ++u)
+                for (size_t i = 0; i < o.size(u); ++i) {
+                    size_t v = o.begin(u)[i];
+                    intersect_sorted(o.begin(u), o.size(u),
+                                     o.begin(v), o.size(v), count);
+                }
+            return found;
+        },
+        [](uint64_t a, uint64_t b) {return a + b;}, threads);
+}
+
+// Number of triangles in the graph; also fills per_vertex[v] with the number
+// of triangles through vertex v.
+inline uint64_t count_triangles(const oriented_adjacency& o,
+                                std::vector<uint64_t>& per_vertex,
+                                size_t threads = 0) {
+    const size_t n = o.num_vertices();
+
+    // each thread credits the vertices of the triangles it finds in its own
+    // array; they are summed at the end
+    std::vector<std::vector<uint64_t> > credit(
+        scheduler::global().num_threads());
+    parallel_for(0, n, 64, [&o, &credit, n](size_t begin, size_t end) {
+        std::vector<uint64_t>& tri = credit[scheduler::slot()];
+        if (tri.empty())
+            tri.assign(n, 0);
+
+        // each match w closes the triangle u, v, w
+        uint64_t found = 0;
+        auto close = [&tri, &found](const uint32_t* block, unsigned mask) {
+            for (; mask != 0; mask &= mask - 1) {
+                ++tri[block[__builtin_ctz(mask)]];
+                ++found;
+            }
+        };
+        for (size_t u = begin; u < end; ++u) {
+            for (size_t i = 0; i < o.size(u); ++i) {
+                size_t v = o.begin(u)[i];
+                found = 0;
+                intersect_sorted(o.begin(u), o.size(u),
+                                 o.begin(v), o.size(v), close);
+                tri[u] += found;
+                tri[v] += found;
+            }
+        }
+    }, threads);
+
+    per_vertex.assign(n, 0);
+    parallel_for(0, n, 4096, [&credit, &per_vertex](size_t begin,
+                                                     size_t end) {
+        for (size_t s = 0; s < credit.size(); ++s)
+            if (!credit[s].empty())
+                for (size_t v = begin; v < end; ++v)
+                    per_vertex[v] += credit[s][v];
+    }, threads);
+
+    // every triangle was credited to each of its three corners
+    uint64_t total = 0;
+    for (size_t v = 0; v < n; ++v)
+        total += per_vertex[v];
+    return total / 3;
+}
+
+// Local clustering coefficient of every vertex: the fraction of pairs of its
+// neighbors that are adjacent, or 0 below degree 2. Returns the average over
+// all vertices.
+inline double clustering_coefficients(const oriented_adjacency& o,
+                                      std::vector<double>& local,
+                                      size_t threads = 0) {
+    std::vector<uint64_t> tri;
+    count_triangles(o, tri, threads);
+
+    double sum = 0;
+    local.assign(o.num_vertices(), 0.0);
+    for (size_t v = 0; v < o.num_vertices(); ++v) {
+        double d = double(o.degree[v]);
+        if (o.degree[v] >= 2)
+            local[v] = 2.0 * tri[v] / (d * (d - 1));
+        sum += local[v];
+    }
+    return o.num_vertices() == 0 ? 0.0 : sum / o.num_vertices();
+}
+
+// The same over a CSR snapshot, indexed by dense vertex index.
+template<typename Graph>
+uint64_t count_triangles(const csr_graph<Graph>& c, size_t threads = 0) {
+    oriented_adjacency o;
+    orient_by_degree(c, o);
+    return count_triangles(o, threads);
+}
+
+template<typename Graph>
+uint64_t count_triangles(const csr_graph<Graph>& c,
+                         std::vector<uint64_t>& per_vertex,
+                         size_t threads = 0) {
+    oriented_adjacency o;
+    orient_by_degree(c, o);
+    return count_triangles(o, per_vertex, threads);
+}
+
+template<typename Graph>
+double clustering_coefficients(const csr_graph<Graph>& c,
+                               std::vector<double>& local,
+                               size_t threads = 0) {
+    oriented_adjacency o;
+    orient_by_degree(c, o);
+    return clustering_coefficients(o, local, threads);
+}
+
+#endif